@@ -19,7 +19,8 @@ namespace IFC {
 		world.component<AttributesRelationship>().add(flecs::Singleton);
 
 		world.component<Attribute>().add(flecs::OnInstantiate, flecs::Inherit);
-		world.component<Value>().member<FString>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
+		world.component<AttributeContainer>().add(flecs::OnInstantiate, flecs::Inherit);
+		world.component<Value>().member<InternedString>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
 
 		// Entities
 		world.component<Alignment>();
@@ -61,18 +62,16 @@ namespace IFC {
 	}
 
 	TArray<flecs::entity> GetAttributes(flecs::world& world, flecs::entity ifcObject) {
-		TMap<FString, flecs::entity> uniqueAttributes;
+		TMap<TTuple<uint64, InternedString, InternedString>, flecs::entity> uniqueAttributes;
 		int32_t index = 0;
 		while (flecs::entity attributes = ifcObject.target(world.try_get<AttributesRelationship>()->Value, index++)) {
 			attributes.children([&](flecs::entity attribute) {
 				if (!attribute.has<Attribute>()) return;
 
-				FString key = FString::Printf(TEXT("%llu|%s|%s"),
+				uniqueAttributes.Add(MakeTuple(
 					(uint64)attribute.id(),
-					*attribute.try_get<Name>()->Value,
-					*attribute.try_get<Owner>()->Value);
-
-				uniqueAttributes.Add(key, attribute);
+					attribute.try_get<Name>()->Value,
+					attribute.try_get<Owner>()->Value), attribute);
 			});
 		}
 
@@ -90,14 +89,14 @@ namespace IFC {
 		return false;
 	}
 
-	FString JsonValueToString(const rapidjson::Value& value) {
+	FString JsonValueToString(const JsonValue& value) {
 		rapidjson::StringBuffer buffer;
 		rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
 		value.Accept(writer);
 		return UTF8_TO_TCHAR(buffer.GetString());
 	}
 
-	static bool TryExtractRefString(const rapidjson::Value& value, FString& out) {
+	static bool TryExtractRefString(const JsonValue& value, FString& out) {
 		if (!value.IsObject()) return false;
 		auto ref = value.FindMember("ref");
 		if (ref == value.MemberEnd() || !ref->value.IsString()) return false;
@@ -105,14 +104,14 @@ namespace IFC {
 		return true;
 	}
 
-	static FString GetValueAsString(const rapidjson::Value& value) {
+	static FString GetValueAsString(const JsonValue& value) {
 		if (value.IsString())
 			return ECS::CleanCode(UTF8_TO_TCHAR(value.GetString()));
 
 		return ECS::CleanCode(JsonValueToString(value));
 	}
 
-	static FString GetAttributeNestedNameAndValue(const rapidjson::Value& value) {
+	static FString GetAttributeNestedNameAndValue(const JsonValue& value) {
 		if (!value.IsObject())
 			return TEXT("");
 
@@ -133,7 +132,7 @@ namespace IFC {
 		return result;
 	}
 
-	static FString GetAttributeNameAndValue(const FString& name, const rapidjson::Value& value) {
+	static FString GetAttributeNameAndValue(const FString& name, const JsonValue& value) {
 		FString result = FString::Printf(TEXT("\n\t\t%s: {\"%s\"}"),
 			UTF8_TO_TCHAR(COMPONENT(Name)),
 			*name);
@@ -146,14 +145,14 @@ namespace IFC {
 		return result;
 	}
 
-	static FString GetAttributeEntity(const FString& name, const rapidjson::Value& value) {
+	static FString GetAttributeEntity(const FString& name, const JsonValue& value) {
 		FString entity = FString::Printf(TEXT("\n\t\t%s"), UTF8_TO_TCHAR(COMPONENT(Attribute)));
 		entity += GetAttributeNameAndValue(name, value);
 		entity += GetAttributeNestedNameAndValue(value);
 		return entity;
 	}
 
-	static FString ProcessRelationship(const FString& relationship, const rapidjson::Value& value) {
+	static FString ProcessRelationship(const FString& relationship, const JsonValue& value) {
 		FString result;
 
 		auto addRef = [&](const FString& refStr) {
@@ -176,12 +175,12 @@ namespace IFC {
 		return result;
 	}
 
-	TTuple<FString, bool> ProcessAttribute(flecs::world& world, const FString& name, const rapidjson::Value& value, const rapidjson::Value& attributes) {
+	TTuple<FString, bool> ProcessAttribute(flecs::world& world, const FString& name, const JsonValue& value, const JsonValue& attributes) {
 		if (name == ATTRIBUTE_XFORMOP) {
-			const rapidjson::Value& transformData = value[ATTRIBUTE_TRANSFROM];
+			const JsonValue& transformData = value[ATTRIBUTE_TRANSFROM];
 			float values[4][4];
 			for (int rowIndex = 0; rowIndex < 4; ++rowIndex) {
-				const rapidjson::Value& transformRowData = transformData[rowIndex];
+				const JsonValue& transformRowData = transformData[rowIndex];
 				for (int columnIndex = 0; columnIndex < 4; ++columnIndex)
 					values[rowIndex][columnIndex] = static_cast<float>(transformRowData[columnIndex].GetDouble());
 			}
@@ -204,14 +203,14 @@ namespace IFC {
 				scale.X, scale.Y, scale.Z);
 
 			// Create Transform Attribute
-			rapidjson::Document transformAttribute(rapidjson::kObjectType);
+			JsonDocument transformAttribute(rapidjson::kObjectType);
 			auto& allocator = transformAttribute.GetAllocator();
-			rapidjson::Value transformObject(rapidjson::kObjectType);
+			JsonValue transformObject(rapidjson::kObjectType);
 
 			auto addVector = [&](const char* key, float x, float y, float z) {
-				rapidjson::Value arr(rapidjson::kArrayType);
+				JsonValue arr(rapidjson::kArrayType);
 				arr.PushBack(x, allocator).PushBack(y, allocator).PushBack(z, allocator);
-				transformObject.AddMember(rapidjson::Value(key, allocator), arr, allocator);
+				transformObject.AddMember(JsonValue(key, allocator), arr, allocator);
 			};
 
 			addVector(COMPONENT(Position), position.X, position.Y, position.Z);
@@ -224,8 +223,8 @@ namespace IFC {
 		}
 
 		if (name == ATTRIBUTE_MESH) {
-			const rapidjson::Value& indicesData = value[MESH_INDICES];
-			const rapidjson::Value& pointsData = value[MESH_POINTS];
+			const JsonValue& indicesData = value[MESH_INDICES];
+			const JsonValue& pointsData = value[MESH_POINTS];
 
 			TArray<int32> indices;
 			indices.Reserve(static_cast<int32>(indicesData.Size()));
@@ -241,10 +240,21 @@ namespace IFC {
 					static_cast<float>(point[1].GetDouble()),
 					static_cast<float>(point[2].GetDouble())));
 
-			return MakeTuple(FString::Printf(TEXT("\n\t\t%s: {%d}"),
+			FTransform frame;
+			FString result = FString::Printf(TEXT("\n\t\t%s: {%d}"),
 				UTF8_TO_TCHAR(COMPONENT(Mesh)),
-				CreateMesh(world, points, indices)),
-				false);
+				CreateMesh(world, points, indices, frame));
+
+			if (!frame.Equals(FTransform::Identity)) {
+				const FVector position = frame.GetLocation();
+				const FRotator rotation = frame.Rotator();
+				result += FString::Printf(TEXT("\n\t\t%s: {{%.6f, %.6f, %.6f}, {%.6f, %.6f, %.6f}}"),
+					UTF8_TO_TCHAR(COMPONENT(MeshFrame)),
+					position.X, position.Y, position.Z,
+					rotation.Pitch, rotation.Yaw, rotation.Roll);
+			}
+
+			return MakeTuple(result, false);
 		}
 
 		if (name == ATTRIBUTE_DIFFUSECOLOR) {
@@ -315,7 +325,7 @@ namespace IFC {
 		return MakeTuple("", false);
 	}
 
-	TTuple<FString, FString, FString> GetAttributes(flecs::world& world, const rapidjson::Value& object, const FString& objectPath) {
+	TTuple<FString, FString, FString> GetAttributes(flecs::world& world, const JsonValue& object, const FString& objectPath) {
 		if (!object.HasMember(ATTRIBUTES_KEY) || !object[ATTRIBUTES_KEY].IsObject())
 			return MakeTuple(FString(), FString(), FString());
 
@@ -323,10 +333,11 @@ namespace IFC {
 		FString attributes = FString::Printf(TEXT("%s {\n"), *path);
 		FString relationships = attributes;
 		attributes += FString::Printf(TEXT("\t%s\n"), UTF8_TO_TCHAR(COMPONENT(IfcObject)));
+		attributes += FString::Printf(TEXT("\t%s\n"), UTF8_TO_TCHAR(COMPONENT(AttributeContainer)));
 
 		bool hasRelationships = false;
 
-		const rapidjson::Value& attributesObject = object[ATTRIBUTES_KEY];
+		const JsonValue& attributesObject = object[ATTRIBUTES_KEY];
 		for (auto attribute = attributesObject.MemberBegin(); attribute != attributesObject.MemberEnd(); ++attribute) {
 			const FString nameAndOwner = UTF8_TO_TCHAR(attribute->name.GetString());
 			FString owner, name;
@@ -337,7 +348,7 @@ namespace IFC {
 
 			FString entities = "";
 
-			const rapidjson::Value& value = attribute->value;
+			const JsonValue& value = attribute->value;
 
 			TTuple <FString, bool> data = ProcessAttribute(world, name, value, attributesObject);
 			FString attributeValue = data.Get<0>();
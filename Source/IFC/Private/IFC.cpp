@@ -4,6 +4,9 @@
 #include "LayerFeature.h"
 #include "AttributeFeature.h"
 #include "ModelFeature.h"
+#include "VisibilityFeature.h"
+#include "StreamingFeature.h"
+#include "MemoryReport.h"
 #include "Assets.h"
 #include "ECS.h"
 #include "ECSCore.h"
@@ -34,8 +37,9 @@ namespace IFC {
 	void Register(flecs::world& world) {
 		using namespace ECS;
 
-		world.component<Id>().member<FString>(VALUE);
-		world.component<Name>().member<FString>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
+		InternedString::Register(world);
+		world.component<Id>().member<InternedString>(VALUE);
+		world.component<Name>().member<InternedString>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
 		world.component<IfcObject>().add(flecs::OnInstantiate, flecs::Inherit);
 
 		world.component<Root>();
@@ -51,13 +55,20 @@ namespace IFC {
 		LayerFeature::CreateComponents(world);
 		AttributeFeature::CreateComponents(world);
 		ModelFeature::CreateComponents(world);
+		VisibilityFeature::CreateComponents(world);
+		StreamingFeature::CreateComponents(world);
 
 		LayerFeature::CreateQueries(world);
+		ModelFeature::CreateQueries(world);
 
 		ModelFeature::CreateObservers(world);
+		ModelFeature::CreateSystems(world);
+		StreamingFeature::CreateSystems(world);
 
 		AttributeFeature::Initialize(world);
 		ModelFeature::Initialize(world);
+
+		RegisterMemoryReport(world);
 	}
 
 	FString Clean(const FString& in) {
@@ -92,14 +103,14 @@ namespace IFC {
 
 	using namespace rapidjson;
 
-	FString GetInheritances(const rapidjson::Value& object, const FString& owner) {
+	FString GetInheritances(const JsonValue& object, const FString& owner) {
 		TArray<FString> inheritIDs;
 
 		if (!owner.IsEmpty())
 			inheritIDs.Add(owner);
 
 		if (object.HasMember(INHERITS_KEY) && object[INHERITS_KEY].IsObject()) {
-			const rapidjson::Value& inherits = object[INHERITS_KEY];
+			const JsonValue& inherits = object[INHERITS_KEY];
 			for (auto inherit = inherits.MemberBegin(); inherit != inherits.MemberEnd(); ++inherit) {
 				FString inheritance = IFC::Scope() + "." + MakeId(UTF8_TO_TCHAR(inherit->value.GetString()));
 				inheritIDs.Add(inheritance);
@@ -109,12 +120,12 @@ namespace IFC {
 		return inheritIDs.Num() > 0 ? TEXT(": ") + FString::Join(inheritIDs, TEXT(", ")) : TEXT("");
 	}
 
-	FString GetChildren(const rapidjson::Value& object, bool isPrefab) {
+	FString GetChildren(const JsonValue& object, bool isPrefab) {
 		if (!object.HasMember(CHILDREN_KEY) || !object[CHILDREN_KEY].IsObject())
 			return TEXT("");
 
 		const FString owner = object[OWNER].GetString();
-		const rapidjson::Value& children = object[CHILDREN_KEY];
+		const JsonValue& children = object[CHILDREN_KEY];
 
 		FString result;
 
@@ -140,8 +151,8 @@ namespace IFC {
 		return result;
 	}
 
-	TArray<const rapidjson::Value*> Sort(const rapidjson::Value& dataArray) {
-		TMap<FString, const rapidjson::Value*> objectMap;
+	TArray<const JsonValue*> Sort(const JsonValue& dataArray) {
+		TMap<FString, const JsonValue*> objectMap;
 		TMap<FString, TArray<FString>> dependencies;
 
 		// Step 1: Build object map and empty dependency list
@@ -189,49 +200,50 @@ namespace IFC {
 			UE_LOG(LogTemp, Warning, TEXT(">>> Cyclic dependency detected in prefab graph."));
 
 		// Step 5: Convert back to JSON pointers
-		TArray<const rapidjson::Value*> sortedObjects;
+		TArray<const JsonValue*> sortedObjects;
 		for (const FString& id : sortedIds)
-			if (const rapidjson::Value** value = objectMap.Find(id))
+			if (const JsonValue** value = objectMap.Find(id))
 				sortedObjects.Add(*value);
 
 		return sortedObjects;
 	}
 
-	void MergeObjectMembers(rapidjson::Value& target, const rapidjson::Value& source, const char* memberName, Document::AllocatorType& allocator) {
+	void MergeObjectMembers(JsonValue& target, const JsonValue& source, const char* memberName, JsonDocument::AllocatorType& allocator) {
 		if (!source.HasMember(memberName) || !source[memberName].IsObject())
 			return;
 
 		if (!target.HasMember(memberName))
-			target.AddMember(rapidjson::Value(memberName, allocator), rapidjson::Value(kObjectType), allocator);
+			target.AddMember(JsonValue(memberName, allocator), JsonValue(kObjectType), allocator);
 
-		rapidjson::Value& targetObject = target[memberName];
-		const rapidjson::Value& sourceObject = source[memberName];
+		JsonValue& targetObject = target[memberName];
+		const JsonValue& sourceObject = source[memberName];
 
 		for (auto member = sourceObject.MemberBegin(); member != sourceObject.MemberEnd(); ++member) {
-			rapidjson::Value key(member->name, allocator);
-			rapidjson::Value value(member->value, allocator);
+			JsonValue key(member->name, allocator);
+			JsonValue value(member->value, allocator);
 			targetObject.RemoveMember(key);
 			targetObject.AddMember(key, value, allocator);
 		}
 	}
 
-	rapidjson::Value Merge(const rapidjson::Value& inputArray, Document::AllocatorType& allocator) {
-		rapidjson::Value mergedArray(kArrayType);
-		TMap<FString, rapidjson::Value> mergedObjects;
+	JsonValue Merge(const JsonValue& inputArray, JsonDocument::AllocatorType& allocator) {
+		LLM_SCOPE_BYTAG(IFC_Json);
+		JsonValue mergedArray(kArrayType);
+		TMap<FString, JsonValue> mergedObjects;
 
 		for (SizeType i = 0; i < inputArray.Size(); ++i) {
-			const rapidjson::Value& object = inputArray[i];
+			const JsonValue& object = inputArray[i];
 			if (!object.IsObject() || !object.HasMember(PATH_KEY) || !object[PATH_KEY].IsString())
 				continue;
 
 			FString id = MakeId(UTF8_TO_TCHAR(object[PATH_KEY].GetString()));
 
 			if (!mergedObjects.Contains(id)) {
-				rapidjson::Value newObj(kObjectType);
+				JsonValue newObj(kObjectType);
 				newObj.CopyFrom(object, allocator);
 				mergedObjects.Add(id, MoveTemp(newObj));
 			} else {
-				rapidjson::Value& existing = mergedObjects[id];
+				JsonValue& existing = mergedObjects[id];
 				MergeObjectMembers(existing, object, INHERITS_KEY, allocator);
 				MergeObjectMembers(existing, object, ATTRIBUTES_KEY, allocator);
 				MergeObjectMembers(existing, object, CHILDREN_KEY, allocator);
@@ -239,19 +251,20 @@ namespace IFC {
 		}
 
 		for (const auto& Pair : mergedObjects) {
-			rapidjson::Value copy(Pair.Value, allocator);
+			JsonValue copy(Pair.Value, allocator);
 			mergedArray.PushBack(copy, allocator);
 		}
 
 		return mergedArray;
 	}
 
-	FString ParseData(flecs::world& world, const rapidjson::Value& data, rapidjson::Document::AllocatorType& allocator) {
-		rapidjson::Value merged = Merge(data, allocator);
-		TArray<const rapidjson::Value*> sorted = Sort(merged);
+	FString ParseData(flecs::world& world, const JsonValue& data, JsonDocument::AllocatorType& allocator) {
+		LLM_SCOPE_BYTAG(IFC_Script);
+		JsonValue merged = Merge(data, allocator);
+		TArray<const JsonValue*> sorted = Sort(merged);
 
 		TSet<FString> entities; // Find entities: non repeating ID
-		for (const rapidjson::Value* object : sorted) {
+		for (const JsonValue* object : sorted) {
 			if (object && object->IsObject())
 				entities.Add(MakeId(UTF8_TO_TCHAR((*object)[PATH_KEY].GetString())));
 			if ((*object).HasMember(CHILDREN_KEY) && (*object)[CHILDREN_KEY].IsObject())
@@ -264,11 +277,17 @@ namespace IFC {
 
 		FString attributesRel = ECS::NormalizedPath(world.try_get<AttributesRelationship>()->Value.path().c_str());
 
+		// Objects carry their owner prefab's path; interned once per layer so each object is one handle lookup
+		TMap<InternedString, FString> layerNames;
+		world.try_get<QueryLayers>()->Value.each([&layerNames](flecs::entity layer) {
+			layerNames.Add(InternedString(GetOwnerPath(GetLayerOwner(layer).ToString())), CleanLayerName(layer.try_get<Id>()->Value.ToString()));
+		});
+
 		FString attributes;
 		FString relationships;
 		FString objects;
 
-		for (const rapidjson::Value* object : sorted) {
+		for (const JsonValue* object : sorted) {
 			if (!object || !object->IsObject())
 				continue;
 
@@ -290,10 +309,8 @@ namespace IFC {
 					components += FString::Printf(TEXT("\t(%s, %s)\n"), *attributesRel, *data.Get<0>());
 			} else {
 				components += FString::Printf(TEXT("\t%s\n"), UTF8_TO_TCHAR(COMPONENT(Root)));
-				world.try_get<QueryLayers>()->Value.each([&owner, &components](flecs::entity layer) {
-					if (owner.Contains(UTF8_TO_TCHAR(layer.name().c_str())))
-						components += FString::Printf(TEXT("\t%s: {\"%s\"}\n"), UTF8_TO_TCHAR(COMPONENT(Name)), *CleanLayerName(layer.try_get<Id>()->Value));
-				});
+				if (const FString* layerName = layerNames.Find(InternedString(owner)))
+					components += FString::Printf(TEXT("\t%s: {\"%s\"}\n"), UTF8_TO_TCHAR(COMPONENT(Name)), **layerName);
 			}
 
 			objects += FString::Printf(TEXT("%s%s.%s%s {\n%s%s}\n"),
@@ -308,24 +325,24 @@ namespace IFC {
 		return attributes + objects + relationships;
 	}
 
-	void InjectOwner(rapidjson::Value& object, const FString& layerPath, rapidjson::Document::AllocatorType& allocator) {
+	void InjectOwner(JsonValue& object, const FString& layerPath, JsonDocument::AllocatorType& allocator) {
 		auto ownerPath = GetOwnerPath(layerPath);
 		if (!object.HasMember(ATTRIBUTES_KEY) || !object[ATTRIBUTES_KEY].IsObject()) {
-			object.AddMember(rapidjson::Value(OWNER, allocator),
-				rapidjson::Value(TCHAR_TO_UTF8(*ownerPath), allocator),
+			object.AddMember(JsonValue(OWNER, allocator),
+				JsonValue(TCHAR_TO_UTF8(*ownerPath), allocator),
 				allocator);
 			return;
 		}
 
-		rapidjson::Value& attributes = object[ATTRIBUTES_KEY];
-		TArray<rapidjson::Value> keys;
-		TArray<rapidjson::Value> values;
+		JsonValue& attributes = object[ATTRIBUTES_KEY];
+		TArray<JsonValue> keys;
+		TArray<JsonValue> values;
 
 		for (auto it = attributes.MemberBegin(); it != attributes.MemberEnd(); ++it) {
 			const FString originalKey = UTF8_TO_TCHAR(it->name.GetString());
 			const FString prefixedKey = ownerPath + ATTRIBUTE_SEPARATOR + originalKey;
-			keys.Add(rapidjson::Value(TCHAR_TO_UTF8(*prefixedKey), allocator));
-			values.Add(rapidjson::Value(it->value, allocator));
+			keys.Add(JsonValue(TCHAR_TO_UTF8(*prefixedKey), allocator));
+			values.Add(JsonValue(it->value, allocator));
 		}
 
 		attributes.RemoveAllMembers();
@@ -334,20 +351,23 @@ namespace IFC {
 			attributes.AddMember(MoveTemp(keys[i]), MoveTemp(values[i]), allocator);
 	}
 
-	void LoadIfcData(flecs::world& world, const TArray<flecs::entity> layers) {
-		rapidjson::Document tempDoc;
-		rapidjson::Document::AllocatorType& allocator = tempDoc.GetAllocator();
-		rapidjson::Value combinedData(rapidjson::kArrayType);
+	void LoadIfcData(flecs::world& world, const TArray<flecs::entity> layers, const MeshBuildSettings& settings) {
+		ModelFeature::BeginLoad(world, settings);
+
+		LLM_SCOPE_BYTAG(IFC_Json);
+		JsonDocument tempDoc;
+		JsonDocument::AllocatorType& allocator = tempDoc.GetAllocator();
+		JsonValue combinedData(rapidjson::kArrayType);
 
 		FString code = FString::Printf(TEXT("using %s\n"), *Scope());
 
 		FString layerNames;
 
 		for (const flecs::entity layer : layers) {
-			FString path = layer.try_get<Path>()->Value;
+			const FString& path = layer.try_get<Path>()->Value.ToString();
 			auto jsonString = Assets::LoadTextFile(path);
 
-			rapidjson::Document doc;
+			JsonDocument doc;
 			if (doc.Parse(jsonString).HasParseError()) {
 				free(jsonString);
 				UE_LOG(LogTemp, Error, TEXT(">>> Parse error in file %s: %s"), *path, *FString(GetParseError_En(doc.GetParseError())));
@@ -366,15 +386,20 @@ namespace IFC {
 			}
 
 			for (auto& entry : doc[DATA_KEY].GetArray()) {
-				rapidjson::Value copy(entry, allocator);
-				InjectOwner(copy, ECS::NormalizedPath(layer.path().c_str()), allocator);
+				JsonValue copy(entry, allocator);
+				InjectOwner(copy, GetLayerOwner(layer), allocator);
 				combinedData.PushBack(copy, allocator);
 			}
 
-			layerNames += layer.try_get<Id>()->Value + " | ";
+			layerNames += layer.try_get<Id>()->Value.ToString() + " | ";
 		}
 
 		code += ParseData(world, combinedData, allocator);
-		ECS::RunCode(world, layerNames, code);
+		{
+			LLM_SCOPE_BYTAG(IFC_Entities);
+			ECS::RunCode(world, layerNames, code);
+		}
+
+		ModelFeature::EndLoad(world);
 	}
 }
\ No newline at end of file
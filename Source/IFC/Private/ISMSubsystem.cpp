@@ -1,17 +1,95 @@
 #include "ISMSubsystem.h"
 #include "MaterialSubsystem.h"
 #include "MeshSubsystem.h"
+#include "MemoryTags.h"
 #include "Components/InstancedStaticMeshComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
 #include "Components/SceneComponent.h"
 #include "GameFramework/Actor.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+#include "RenderingThread.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Unique.h"
 
-uint64 UISMSubsystem::MakeIsmHandle(int32 meshId, int32 instanceIndex) {
-	return (uint64(uint32(meshId)) << 32) | uint64(uint32(instanceIndex));
+static constexpr uint64 BatchHandleBit = 1ull << 63;
+static constexpr uint32 GenerationMask = 0x7FFFFFFF;
+
+uint64 UISMSubsystem::MakeIsmHandle(int32 slot, uint32 generation) {
+	return (uint64(generation & GenerationMask) << 32) | uint64(uint32(slot));
+}
+
+void UISMSubsystem::SplitIsmHandle(uint64 id, int32& outSlot, uint32& outGeneration) {
+	outSlot = int32(uint32(id));
+	outGeneration = uint32(id >> 32) & GenerationMask;
+}
+
+uint64 UISMSubsystem::MakeBatchHandle(int32 batchId, int32 rangeIndex) {
+	return BatchHandleBit | (uint64(uint32(batchId)) << 32) | uint64(uint32(rangeIndex));
+}
+
+int32 UISMSubsystem::AllocateSlot(int32 groupId, int32 instanceIndex) {
+	const int32 slot = FreeSlots.Num() > 0 ? FreeSlots.Pop() : Slots.AddDefaulted();
+	Slots[slot].GroupId = groupId;
+	Slots[slot].InstanceIndex = instanceIndex;
+	return slot;
+}
+
+void UISMSubsystem::FreeSlot(int32 slot) {
+	ISMSlot& entry = Slots[slot];
+	entry.GroupId = INDEX_NONE;
+	entry.InstanceIndex = INDEX_NONE;
+	// Generation 0 is never handed out so a zero handle stays invalid
+	entry.Generation = ((entry.Generation + 1) & GenerationMask) == 0 ? 1 : entry.Generation + 1;
+	FreeSlots.Add(slot);
+}
+
+bool UISMSubsystem::ResolveHandle(uint64 handle, int32& outGroupId, int32& outInstanceIndex) const {
+	if (IsBatchHandle(handle)) return false;
+	int32 slot;
+	uint32 generation;
+	SplitIsmHandle(handle, slot, generation);
+	if (!Slots.IsValidIndex(slot)) return false;
+	const ISMSlot& entry = Slots[slot];
+	if (entry.Generation != generation || entry.GroupId == INDEX_NONE) return false;
+	outGroupId = entry.GroupId;
+	outInstanceIndex = entry.InstanceIndex;
+	return true;
+}
+
+uint64 UISMSubsystem::GetHandle(int32 groupId, int32 instanceIndex) const {
+	const ISMGroup* group = GroupData.Find(groupId);
+	if (!group || !group->InstanceSlots.IsValidIndex(instanceIndex)) return 0;
+	const int32 slot = group->InstanceSlots[instanceIndex];
+	return MakeIsmHandle(slot, Slots[slot].Generation);
+}
+
+TObjectPtr<UInstancedStaticMeshComponent>* UISMSubsystem::FindGroup(int32 groupId) {
+	return GroupData.Contains(groupId) ? &Groups[TSlotMap<ISMGroup>::IndexOf(groupId)] : nullptr;
 }
 
-void UISMSubsystem::SplitIsmHandle(uint64 id, int32& outMeshId, int32& outInstanceIndex) {
-	outMeshId = int32(uint32(id >> 32));
-	outInstanceIndex = int32(uint32(id));
+UInstancedStaticMeshComponent* UISMSubsystem::GetGroupComponent(int32 groupId) const {
+	return GroupData.Contains(groupId) ? Groups[TSlotMap<ISMGroup>::IndexOf(groupId)].Get() : nullptr;
+}
+
+TArray<ISMGroupMemory> UISMSubsystem::GetGroupMemory() const {
+	TArray<ISMGroupMemory> groups;
+	GroupData.ForEach([&](int32 groupId, const ISMGroup& group) {
+		ISMGroupMemory& memory = groups.Add_GetRef({ group.MeshId, group.MaterialKey });
+		memory.Bytes = group.InstanceSlots.GetAllocatedSize() + group.InstanceMaterials.GetAllocatedSize();
+		if (const PendingGroup* pending = PendingInstances.Find(groupId))
+			memory.Bytes += pending->Transforms.GetAllocatedSize() + pending->CustomData.GetAllocatedSize();
+		if (const UInstancedStaticMeshComponent* ism = GetGroupComponent(groupId)) {
+			memory.Instances = ism->GetInstanceCount();
+			memory.Bytes += ism->PerInstanceSMData.GetAllocatedSize() + ism->PerInstanceSMCustomData.GetAllocatedSize();
+		}
+	});
+	return groups;
+}
+
+bool UISMSubsystem::IsBatchHandle(uint64 handle) {
+	return (handle & BatchHandleBit) != 0;
 }
 
 AActor* UISMSubsystem::EnsureRoot(UWorld* world) {
@@ -33,100 +111,431 @@ AActor* UISMSubsystem::EnsureRoot(UWorld* world) {
 	return actor;
 }
 
-UInstancedStaticMeshComponent* UISMSubsystem::GetOrCreateIsm(UWorld* world, int32 meshId, int32 materialId) {
-	if (TObjectPtr<UInstancedStaticMeshComponent>* found = ByMeshId.Find(meshId)) return found->Get();
+int32 UISMSubsystem::GetOrCreateGroup(UWorld* world, int32 meshId, int32 materialId) {
+	UMaterialSubsystem* materialSubsystem = world->GetSubsystem<UMaterialSubsystem>();
+	const MaterialInstanceData* instanceData = materialSubsystem->FindInstanceData(materialId);
+	const int32 materialKey = !instanceData ? materialId : instanceData->Opaque ? InstancedOpaqueKey : InstancedTranslucentKey;
+	if (const int32* found = GroupByKey.Find(MakeTuple(meshId, materialKey))) return *found;
+
 	UMeshSubsystem* meshSubsystem = world->GetSubsystem<UMeshSubsystem>();
-	UStaticMesh* mesh = meshSubsystem->Get(meshId);
+	UStaticMesh* mesh = meshSubsystem->GetResident(meshId);
 	AActor* owner = EnsureRoot(world);
+	if (!owner) return INDEX_NONE;
 
 	UInstancedStaticMeshComponent* ism = NewObject<UInstancedStaticMeshComponent>(owner);
-	if (!ism) return nullptr;
+	if (!ism) return INDEX_NONE;
 	ism->SetStaticMesh(mesh);
 	ism->SetupAttachment(owner->GetRootComponent());
 	ism->SetMobility(EComponentMobility::Movable);
 	ism->RegisterComponent();
 	ism->SetVisibility(true, true);
 
-	UMaterialSubsystem* materialSubsystem = world->GetSubsystem<UMaterialSubsystem>();
-	UMaterialInterface* material = materialSubsystem->Get(materialId);
-	materialSubsystem->Retain(materialId);
-	ism->SetMaterial(0, material);
+	int32 numCustomData = instanceData ? InstancedColorFloats : 0;
+	if (Instancing.VisibilityMasks) numCustomData = VisibilityMaskChannel + 1;
+	if (Instancing.CustomDataFloats > 0) numCustomData = UserCustomDataChannel + Instancing.CustomDataFloats;
+	if (numCustomData > 0) ism->SetNumCustomDataFloats(numCustomData);
+	if (instanceData) {
+		ism->SetMaterial(0, materialSubsystem->GetInstancedMaster(instanceData->Opaque));
+	} else {
+		ism->SetMaterial(0, materialSubsystem->Get(materialId));
+		materialSubsystem->Retain(materialId);
+	}
 	ism->MarkRenderStateDirty();
 
-	ByMeshId.Add(meshId, ism);
+	const int32 groupId = GroupData.Add(ISMGroup());
+	ISMGroup& group = GroupData[groupId];
+	group.MeshId = meshId;
+	group.MaterialKey = materialKey;
+	const int32 index = TSlotMap<ISMGroup>::IndexOf(groupId);
+	if (index >= Groups.Num()) Groups.SetNum(index + 1);
+	Groups[index] = ism;
+	GroupByKey.Add(MakeTuple(meshId, materialKey), groupId);
 	meshSubsystem->Retain(meshId);
-	return ism;
+	return groupId;
 }
 
 uint64 UISMSubsystem::CreateISM(UWorld* world, int32 meshId, int32 materialId, const FVector& position, const FRotator& rotation, const FVector& scale) {
-	UInstancedStaticMeshComponent* ism = GetOrCreateIsm(world, meshId, materialId);
+	LLM_SCOPE_BYTAG(IFC_Instances);
+	const int32 groupId = GetOrCreateGroup(world, meshId, materialId);
+	UInstancedStaticMeshComponent* ism = GetGroupComponent(groupId);
 	if (!ism) return 0;
+	ISMGroup& group = GroupData[groupId];
+
+	// RGBA and offset of instanced-color materials
+	float customData[InstancedColorFloats];
+	const MaterialInstanceData* instanceData = world->GetSubsystem<UMaterialSubsystem>()->FindInstanceData(materialId);
+	if (instanceData) {
+		customData[0] = instanceData->Color.X;
+		customData[1] = instanceData->Color.Y;
+		customData[2] = instanceData->Color.Z;
+		customData[3] = instanceData->Color.W;
+		customData[4] = instanceData->Offset;
+	}
+
 	FTransform transform(rotation, position, scale);
-	int32 instanceIndex = ism->AddInstance(transform, true);
-	if (instanceIndex < 0) return 0;
-	return MakeIsmHandle(meshId, instanceIndex);
+	int32 instanceIndex;
+	if (Batching) {
+		PendingGroup& pending = PendingInstances.FindOrAdd(groupId);
+		instanceIndex = ism->GetInstanceCount() + pending.Transforms.Num();
+		pending.Transforms.Add(transform);
+		if (instanceData) pending.CustomData.Append(customData, InstancedColorFloats);
+	} else {
+		if (ShouldBeHierarchical(ism, ism->GetInstanceCount() + 1)) ism = ConvertToHierarchical(groupId);
+		instanceIndex = ism->AddInstance(transform, true);
+		if (instanceIndex < 0) return 0;
+	}
+
+	const int32 slot = AllocateSlot(groupId, instanceIndex);
+	group.InstanceSlots.Add(slot);
+	const uint64 handle = MakeIsmHandle(slot, Slots[slot].Generation);
+	if (instanceData) {
+		group.InstanceMaterials.Add(materialId);
+		if (!Batching)
+			for (int32 i = 0; i < InstancedColorFloats; ++i) SetISMCustomData(handle, i, customData[i]);
+	}
+	return handle;
+}
+
+void UISMSubsystem::CreateISMs(UWorld* world, TArrayView<const ISMCreateRequest> requests, TArray<uint64>& outHandles) {
+	LLM_SCOPE_BYTAG(IFC_Instances);
+	const bool wasBatching = Batching;
+	Batching = true;
+	outHandles.Reset(requests.Num());
+	for (const ISMCreateRequest& request : requests)
+		outHandles.Add(CreateISM(world, request.MeshId, request.MaterialId, request.Transform.GetLocation(), request.Transform.Rotator(), request.Transform.GetScale3D()));
+	if (!wasBatching) EndBatch();
+}
+
+void UISMSubsystem::BeginBatch() {
+	Batching = true;
+}
+
+void UISMSubsystem::EndBatch() {
+	Batching = false;
+	TArray<int32> groupIds;
+	PendingInstances.GetKeys(groupIds);
+	for (int32 groupId : groupIds) FlushPending(groupId);
+}
+
+void UISMSubsystem::FlushPending(int32 groupId) {
+	LLM_SCOPE_BYTAG(IFC_Instances);
+	PendingGroup pending;
+	if (!PendingInstances.RemoveAndCopyValue(groupId, pending) || pending.Transforms.Num() == 0) return;
+	UInstancedStaticMeshComponent* ism = nullptr;
+	if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId)) ism = found->Get();
+	if (!ism) return;
+	// Convert before adding so the bulk lands in a single tree build
+	if (ShouldBeHierarchical(ism, ism->GetInstanceCount() + pending.Transforms.Num())) ism = ConvertToHierarchical(groupId);
+	const int32 firstIndex = ism->GetInstanceCount();
+	ism->AddInstances(pending.Transforms, false, true);
+	if (pending.CustomData.Num() == pending.Transforms.Num() * InstancedColorFloats)
+		for (int32 i = 0; i < pending.Transforms.Num(); ++i)
+			ism->SetCustomData(firstIndex + i, MakeArrayView(&pending.CustomData[i * InstancedColorFloats], InstancedColorFloats));
+	ism->MarkRenderStateDirty();
+}
+
+void UISMSubsystem::SetInstancingSettings(const MeshInstancingSettings& settings) {
+	Instancing = settings;
+}
+
+bool UISMSubsystem::ShouldBeHierarchical(const UInstancedStaticMeshComponent* ism, int32 instanceCount) const {
+	return Instancing.Hierarchical && instanceCount > Instancing.HierarchicalThreshold && !ism->IsA<UHierarchicalInstancedStaticMeshComponent>();
+}
+
+UInstancedStaticMeshComponent* UISMSubsystem::ConvertToHierarchical(int32 groupId) {
+	UInstancedStaticMeshComponent* ism = GetGroupComponent(groupId);
+	AActor* owner = ism->GetOwner();
+	UHierarchicalInstancedStaticMeshComponent* hism = NewObject<UHierarchicalInstancedStaticMeshComponent>(owner);
+	if (!hism) return ism;
+	hism->SetStaticMesh(ism->GetStaticMesh());
+	hism->SetupAttachment(owner->GetRootComponent());
+	hism->SetMobility(EComponentMobility::Movable);
+	hism->SetMaterial(0, ism->GetMaterial(0));
+	hism->SetNumCustomDataFloats(ism->NumCustomDataFloats);
+	hism->RegisterComponent();
+	hism->SetVisibility(ism->IsVisible(), true);
+
+	// Instance indices are preserved, so existing handles keep resolving
+	const int32 count = ism->GetInstanceCount();
+	TArray<FTransform> transforms;
+	transforms.SetNum(count);
+	for (int32 i = 0; i < count; ++i) ism->GetInstanceTransform(i, transforms[i], true);
+	hism->AddInstances(transforms, false, true);
+	const int32 numCustomData = ism->NumCustomDataFloats;
+	if (numCustomData > 0)
+		for (int32 i = 0; i < count; ++i)
+			hism->SetCustomData(i, MakeArrayView(&ism->PerInstanceSMCustomData[i * numCustomData], numCustomData));
+	// Cluster tree is built on a worker; the component renders unculled until it is ready
+	hism->BuildTreeIfOutdated(true, false);
+
+	*FindGroup(groupId) = hism;
+	ism->DestroyComponent();
+	return hism;
 }
 
 bool UISMSubsystem::UpdateISMTransform(uint64 handle, const FTransform& transform, bool worldSpace, bool markRenderStateDirty, bool teleport) {
-	int32 meshId, instanceIndex;
-	SplitIsmHandle(handle, meshId, instanceIndex);
+	int32 groupId, instanceIndex;
+	if (!ResolveHandle(handle, groupId, instanceIndex)) return false;
+	FlushPending(groupId);
 	UInstancedStaticMeshComponent* ism = nullptr;
-	if (TObjectPtr<UInstancedStaticMeshComponent>* found = ByMeshId.Find(meshId)) ism = found->Get();
+	if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId)) ism = found->Get();
 	if (!ism) return false;
 	if (instanceIndex < 0 || instanceIndex >= ism->GetInstanceCount()) return false;
 	return ism->UpdateInstanceTransform(instanceIndex, transform, worldSpace, markRenderStateDirty, teleport);
 }
 
+int32 UISMSubsystem::UpdateISMTransforms(TArrayView<const uint64> handles, TArrayView<const FTransform> transforms, bool teleport) {
+	check(handles.Num() == transforms.Num());
+	int32 updated = 0;
+	int32 batched = 0;
+	for (int32 i = 0; i < handles.Num(); ++i) {
+		batched += IsBatchHandle(handles[i]) ? 1 : 0;
+		int32 groupId, instanceIndex;
+		if (!ResolveHandle(handles[i], groupId, instanceIndex)) continue;
+		FlushPending(groupId);
+		UInstancedStaticMeshComponent* ism = nullptr;
+		if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId)) ism = found->Get();
+		if (!ism || instanceIndex < 0 || instanceIndex >= ism->GetInstanceCount()) continue;
+		if (!ism->UpdateInstanceTransform(instanceIndex, transforms[i], true, false, teleport)) continue;
+		DirtyGroups.Add(groupId);
+		++updated;
+	}
+	if (batched > 0)
+		UE_LOG(LogTemp, Warning, TEXT(">>> %d batched objects keep their place, their geometry is merged; disable batching to move them"), batched);
+	return updated;
+}
+
 void UISMSubsystem::SetISMCustomData(uint64 id, int32 customIndex, float value) {
-	int32 meshId = -1, instanceIndex = -1;
-	SplitIsmHandle(id, meshId, instanceIndex);
+	int32 groupId = -1, instanceIndex = -1;
+	if (!ResolveHandle(id, groupId, instanceIndex)) return;
+	FlushPending(groupId);
 
 	UInstancedStaticMeshComponent* component = nullptr;
-	if (TObjectPtr<UInstancedStaticMeshComponent>* found = ByMeshId.Find(meshId))
+	if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId))
 		component = found->Get();
 	if (!component) return;
 
 	const int32 count = component->GetInstanceCount();
 	if (instanceIndex < 0 || instanceIndex >= count) return;
 
-	if (component->NumCustomDataFloats <= customIndex) {
+	if (component->NumCustomDataFloats <= customIndex)
 		component->SetNumCustomDataFloats(customIndex + 1);
-		component->MarkRenderStateDirty();
+
+	component->SetCustomDataValue(instanceIndex, customIndex, value, false);
+	DirtyGroups.Add(groupId);
+}
+
+int32 UISMSubsystem::SetISMCustomDataBulk(TArrayView<const ISMCustomDataUpdate> updates) {
+	int32 written = 0;
+	int32 groupId = INDEX_NONE;
+	UInstancedStaticMeshComponent* ism = nullptr;
+	for (const ISMCustomDataUpdate& update : updates) {
+		int32 updateGroupId, instanceIndex;
+		if (!ResolveHandle(update.Handle, updateGroupId, instanceIndex)) continue;
+		// Updates usually arrive grouped, so the component lookup is skipped for runs of one group
+		if (updateGroupId != groupId) {
+			groupId = updateGroupId;
+			FlushPending(groupId);
+			TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId);
+			ism = found ? found->Get() : nullptr;
+		}
+		if (!ism || update.Channel < 0 || update.Channel >= ism->NumCustomDataFloats) continue;
+		if (instanceIndex < 0 || instanceIndex >= ism->GetInstanceCount()) continue;
+		// Through the component, so HISM and the instance data manager see the change; the render state is marked once in FlushRenderState
+		if (!ism->SetCustomDataValue(instanceIndex, update.Channel, update.Value, false)) continue;
+		DirtyGroups.Add(groupId);
+		++written;
 	}
+	return written;
+}
+
+int32 UISMSubsystem::SetISMGroupCustomData(int32 groupId, int32 channel, TArrayView<const float> values) {
+	FlushPending(groupId);
+	UInstancedStaticMeshComponent* ism = nullptr;
+	if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId)) ism = found->Get();
+	if (!ism || channel < 0 || channel >= ism->NumCustomDataFloats) return 0;
+
+	const int32 count = FMath::Min(values.Num(), ism->GetInstanceCount());
+	int32 written = 0;
+	for (int32 i = 0; i < count; ++i)
+		written += ism->SetCustomDataValue(i, channel, values[i], false) ? 1 : 0;
+	if (written > 0) DirtyGroups.Add(groupId);
+	return written;
+}
 
-	component->SetCustomDataValue(instanceIndex, customIndex, value, true);
+void UISMSubsystem::FlushRenderState() {
+	for (int32 groupId : DirtyGroups)
+		if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId))
+			if (UInstancedStaticMeshComponent* ism = found->Get())
+				ism->MarkRenderStateDirty();
+	DirtyGroups.Reset();
+	for (int32 batchId : DirtyBatches) UploadBatchIndices(batchId);
+	DirtyBatches.Reset();
 }
 
 
-bool UISMSubsystem::SetISMNumCustomDataFloats(int32 meshId, int32 numFloats) {
+bool UISMSubsystem::SetISMNumCustomDataFloats(int32 groupId, int32 numFloats) {
 	UInstancedStaticMeshComponent* ism = nullptr;
-	if (TObjectPtr<UInstancedStaticMeshComponent>* found = ByMeshId.Find(meshId)) ism = found->Get();
+	if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId)) ism = found->Get();
 	if (!ism) return false;
 	if (numFloats <= 0) return false;
 	ism->SetNumCustomDataFloats(numFloats);
 	return true;
 }
 
-int32 UISMSubsystem::GetISMInstanceCount(int32 meshId) const {
-	const UInstancedStaticMeshComponent* ism = nullptr;
-	if (const TObjectPtr<UInstancedStaticMeshComponent>* found = ByMeshId.Find(meshId)) ism = found->Get();
+int32 UISMSubsystem::GetISMInstanceCount(int32 groupId) const {
+	const UInstancedStaticMeshComponent* ism = GetGroupComponent(groupId);
 	if (!ism) return 0;
-	return ism->GetInstanceCount();
+	const PendingGroup* pending = PendingInstances.Find(groupId);
+	return ism->GetInstanceCount() + (pending ? pending->Transforms.Num() : 0);
 }
 
-void UISMSubsystem::DestroyGroup(UWorld* world, int32 meshId) {
+void UISMSubsystem::DestroyGroup(UWorld* world, int32 groupId) {
 	UInstancedStaticMeshComponent* ism = nullptr;
-	if (TObjectPtr<UInstancedStaticMeshComponent>* found = ByMeshId.Find(meshId)) ism = found->Get();
+	if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId)) ism = found->Get();
 	if (!ism) return;
-	ByMeshId.Remove(meshId);
-	if (UMeshSubsystem* meshSub = world->GetSubsystem<UMeshSubsystem>()) meshSub->Release(meshId, false);
+	*FindGroup(groupId) = nullptr;
+	PendingInstances.Remove(groupId);
+	DirtyGroups.Remove(groupId);
+	ISMGroup group;
+	if (GroupData.Remove(groupId, &group)) {
+		for (int32 slot : group.InstanceSlots) FreeSlot(slot);
+		GroupByKey.Remove(MakeTuple(group.MeshId, group.MaterialKey));
+		if (UMeshSubsystem* meshSub = world->GetSubsystem<UMeshSubsystem>()) meshSub->Release(group.MeshId, false);
+		if (group.MaterialKey >= 0)
+			if (UMaterialSubsystem* materialSub = world->GetSubsystem<UMaterialSubsystem>()) materialSub->Release(group.MaterialKey);
+	}
 	ism->DestroyComponent();
 }
 
+bool UISMSubsystem::RemoveISM(UWorld* world, uint64 handle) {
+	if (IsBatchHandle(handle)) {
+		int32 batchId, rangeIndex;
+		if (!FindBatchRange(handle, batchId, rangeIndex)) return false;
+		ISMBatch& batch = Batches[batchId];
+		batch.Ranges[rangeIndex].Owner = 0;
+		batch.Ranges[rangeIndex].Hidden = true;
+		if (batch.Ranges.ContainsByPredicate([](const ISMBatchRange& range) { return range.Owner != 0; })) DirtyBatches.Add(batchId);
+		else DestroyBatch(world, batchId);
+		return true;
+	}
+
+	int32 groupId, instanceIndex;
+	if (!ResolveHandle(handle, groupId, instanceIndex)) return false;
+	FlushPending(groupId);
+	UInstancedStaticMeshComponent* ism = GetGroupComponent(groupId);
+	ISMGroup& group = GroupData[groupId];
+	if (!ism) return false;
+
+	// Move the last instance into the hole so only one slot changes index
+	const int32 last = ism->GetInstanceCount() - 1;
+	if (instanceIndex != last) {
+		FTransform transform;
+		ism->GetInstanceTransform(last, transform, true);
+		ism->UpdateInstanceTransform(instanceIndex, transform, true, false, true);
+		const int32 numCustomData = ism->NumCustomDataFloats;
+		if (numCustomData > 0) {
+			TArray<float> customData(&ism->PerInstanceSMCustomData[last * numCustomData], numCustomData);
+			ism->SetCustomData(instanceIndex, customData);
+		}
+		const int32 movedSlot = group.InstanceSlots[last];
+		group.InstanceSlots[instanceIndex] = movedSlot;
+		Slots[movedSlot].InstanceIndex = instanceIndex;
+		if (group.InstanceMaterials.IsValidIndex(last)) group.InstanceMaterials[instanceIndex] = group.InstanceMaterials[last];
+	}
+	FreeSlot(group.InstanceSlots.Pop());
+	if (group.InstanceMaterials.IsValidIndex(last)) group.InstanceMaterials.Pop();
+	ism->RemoveInstance(last);
+
+	if (ism->GetInstanceCount() == 0) DestroyGroup(world, groupId);
+	return true;
+}
+
+int32 UISMSubsystem::RemoveISMs(UWorld* world, TArrayView<const uint64> handles) {
+	TMap<int32, TArray<int32>> removedByGroup;
+	TSet<int32> touchedBatches;
+	int32 removed = 0;
+	for (uint64 handle : handles) {
+		int32 groupId, instanceIndex;
+		if (ResolveHandle(handle, groupId, instanceIndex)) {
+			removedByGroup.FindOrAdd(groupId).Add(instanceIndex);
+			continue;
+		}
+		int32 batchId, rangeIndex;
+		if (!FindBatchRange(handle, batchId, rangeIndex)) continue;
+		ISMBatchRange& range = Batches[batchId].Ranges[rangeIndex];
+		range.Owner = 0;
+		range.Hidden = true;
+		touchedBatches.Add(batchId);
+		++removed;
+	}
+
+	for (TPair<int32, TArray<int32>>& entry : removedByGroup) {
+		const int32 groupId = entry.Key;
+		FlushPending(groupId);
+		UInstancedStaticMeshComponent* ism = GetGroupComponent(groupId);
+		if (!ism) continue;
+		ISMGroup& group = GroupData[groupId];
+		TArray<int32>& holes = entry.Value;
+		holes.Sort();
+		holes.SetNum(Algo::Unique(holes));
+		const int32 count = ism->GetInstanceCount();
+		TBitArray<> removing(false, count);
+		for (int32 hole : holes) {
+			removing[hole] = true;
+			FreeSlot(group.InstanceSlots[hole]);
+		}
+
+		// Fill holes from the highest surviving instances so the removed block ends up at the tail
+		const int32 numCustomData = ism->NumCustomDataFloats;
+		int32 last = count - 1;
+		for (int32 hole : holes) {
+			while (last > hole && removing[last]) --last;
+			if (last <= hole) break;
+			FTransform transform;
+			ism->GetInstanceTransform(last, transform, true);
+			ism->UpdateInstanceTransform(hole, transform, true, false, true);
+			if (numCustomData > 0) {
+				TArray<float> customData(&ism->PerInstanceSMCustomData[last * numCustomData], numCustomData);
+				ism->SetCustomData(hole, customData);
+			}
+			const int32 movedSlot = group.InstanceSlots[last];
+			group.InstanceSlots[hole] = movedSlot;
+			Slots[movedSlot].InstanceIndex = hole;
+			if (group.InstanceMaterials.IsValidIndex(last)) group.InstanceMaterials[hole] = group.InstanceMaterials[last];
+			--last;
+		}
+
+		const int32 remaining = count - holes.Num();
+		group.InstanceSlots.SetNum(remaining);
+		if (group.InstanceMaterials.Num() > remaining) group.InstanceMaterials.SetNum(remaining);
+		removed += holes.Num();
+		if (remaining == 0) {
+			DestroyGroup(world, groupId);
+			continue;
+		}
+		TArray<int32> tail;
+		tail.Reserve(holes.Num());
+		for (int32 i = count - 1; i >= remaining; --i) tail.Add(i);
+		ism->RemoveInstances(tail);
+		DirtyGroups.Add(groupId);
+	}
+
+	for (int32 batchId : touchedBatches) {
+		const bool empty = !Batches[batchId].Ranges.ContainsByPredicate([](const ISMBatchRange& range) { return range.Owner != 0; });
+		if (empty) DestroyBatch(world, batchId);
+		else DirtyBatches.Add(batchId);
+	}
+	return removed;
+}
+
 void UISMSubsystem::DestroyAll(UWorld* world) {
 	TArray<int32> keys;
-	ByMeshId.GetKeys(keys);
-	for (int32 meshId : keys) DestroyGroup(world, meshId);
+	GroupData.ForEach([&](int32 groupId, const ISMGroup&) { keys.Add(groupId); });
+	for (int32 groupId : keys) DestroyGroup(world, groupId);
+	TArray<int32> batchIds;
+	Batches.GetKeys(batchIds);
+	for (int32 batchId : batchIds) DestroyBatch(world, batchId);
 	if (Root) {
 		Root->Destroy();
 		Root = nullptr;
@@ -134,11 +543,18 @@ void UISMSubsystem::DestroyAll(UWorld* world) {
 }
 
 FBoxSphereBounds UISMSubsystem::GetBounds(uint64 id) {
-	int32 meshId, instanceIndex;
-	SplitIsmHandle(id, meshId, instanceIndex);
+	if (IsBatchHandle(id)) {
+		int32 batchId, rangeIndex;
+		if (!FindBatchRange(id, batchId, rangeIndex)) return FBoxSphereBounds(ForceInit);
+		return Batches[batchId].Ranges[rangeIndex].Bounds;
+	}
+
+	int32 groupId, instanceIndex;
+	if (!ResolveHandle(id, groupId, instanceIndex)) return FBoxSphereBounds(ForceInit);
+	FlushPending(groupId);
 
 	UInstancedStaticMeshComponent* ism = nullptr;
-	if (TObjectPtr<UInstancedStaticMeshComponent>* found = ByMeshId.Find(meshId))
+	if (TObjectPtr<UInstancedStaticMeshComponent>* found = FindGroup(groupId))
 		ism = found->Get();
 	if (!ism)
 		return FBoxSphereBounds(ForceInit);
@@ -163,3 +579,227 @@ FBoxSphereBounds UISMSubsystem::GetBounds(uint64 id) {
 
 	return FBoxSphereBounds(center, extent, radius);
 }
+
+TMap<uint64, uint64> UISMSubsystem::BatchSingleInstanceGroups(UWorld* world, const MeshBatchSettings& settings, const TMap<uint64, uint64>& owners) {
+	TMap<uint64, uint64> remapped;
+	UMeshSubsystem* meshSubsystem = world->GetSubsystem<UMeshSubsystem>();
+	UMaterialSubsystem* materialSubsystem = world->GetSubsystem<UMaterialSubsystem>();
+	AActor* owner = EnsureRoot(world);
+	if (!owner) return remapped;
+
+	struct Candidate {
+		int32 GroupId;
+		uint64 Handle;
+		int32 MeshId;
+		FTransform Transform;
+		FBoxSphereBounds Bounds;
+		MeshBuffers Buffers;
+	};
+
+	// Material + cell -> candidates
+	TMap<TTuple<int32, FIntVector>, TArray<Candidate>> cells;
+	TArray<int32> groupIds;
+	GroupData.ForEach([&](int32 groupId, const ISMGroup&) { groupIds.Add(groupId); });
+	for (int32 groupId : groupIds) {
+		UInstancedStaticMeshComponent* ism = GetGroupComponent(groupId);
+		if (!ism || ism->GetInstanceCount() != 1 || !ism->GetStaticMesh()) continue;
+		const ISMGroup& data = GroupData[groupId];
+		const int32 materialId = data.MaterialKey >= 0 ? data.MaterialKey : data.InstanceMaterials.Num() == 1 ? data.InstanceMaterials[0] : INDEX_NONE;
+		if (materialId == INDEX_NONE) continue;
+
+		Candidate candidate;
+		candidate.GroupId = groupId;
+		candidate.Handle = GetHandle(groupId, 0);
+		candidate.MeshId = data.MeshId;
+		if (!meshSubsystem->ReadBuffers(data.MeshId, candidate.Buffers)) continue;
+		if (candidate.Buffers.NumTriangles() > settings.MaxObjectTriangles) continue;
+		if (!ism->GetInstanceTransform(0, candidate.Transform, true)) continue;
+		candidate.Bounds = ism->GetStaticMesh()->GetBounds().TransformBy(candidate.Transform);
+
+		const FVector cell = candidate.Bounds.Origin / settings.CellSize;
+		const FIntVector cellKey(FMath::FloorToInt(cell.X), FMath::FloorToInt(cell.Y), FMath::FloorToInt(cell.Z));
+		cells.FindOrAdd(MakeTuple(materialId, cellKey)).Add(MoveTemp(candidate));
+	}
+
+	int32 batchedObjects = 0;
+	const int32 firstBatchId = NextBatchId;
+	for (TPair<TTuple<int32, FIntVector>, TArray<Candidate>>& cell : cells) {
+		TArray<Candidate>& candidates = cell.Value;
+		if (candidates.Num() < 2) continue;
+		candidates.Sort([](const Candidate& a, const Candidate& b) { return a.MeshId < b.MeshId; });
+
+		const int32 materialId = cell.Key.Get<0>();
+		const FVector origin = (FVector(cell.Key.Get<1>()) + FVector(0.5)) * settings.CellSize;
+
+		for (int32 start = 0; start < candidates.Num();) {
+			const int32 batchId = NextBatchId++;
+			ISMBatch& batch = Batches.Add(batchId);
+			batch.MaterialId = materialId;
+			batch.Origin = origin;
+
+			MeshBuffers merged;
+			int32 end = start;
+			for (; end < candidates.Num(); ++end) {
+				const Candidate& candidate = candidates[end];
+				if (end > start && merged.NumVertices() + candidate.Buffers.NumVertices() > settings.MaxBatchVertices) break;
+
+				// Positions relative to the cell centre keep float precision on large sites
+				const FMatrix normalMatrix = candidate.Transform.ToMatrixWithScale().InverseFast().GetTransposed();
+				const bool mirrored = candidate.Transform.GetDeterminant() < 0.0f;
+				const uint32 baseVertex = merged.NumVertices();
+				for (int32 v = 0; v < candidate.Buffers.NumVertices(); ++v) {
+					merged.Positions.Add(FVector3f(candidate.Transform.TransformPosition(FVector(candidate.Buffers.Positions[v])) - origin));
+					merged.Normals.Add(FVector3f(normalMatrix.TransformVector(FVector(candidate.Buffers.Normals[v])).GetSafeNormal()));
+					merged.UVs.Add(candidate.Buffers.UVs[v]);
+				}
+
+				ISMBatchRange& range = batch.Ranges.AddDefaulted_GetRef();
+				range.FirstTriangle = merged.NumTriangles();
+				range.NumTriangles = candidate.Buffers.NumTriangles();
+				range.Bounds = candidate.Bounds;
+				const uint64 oldHandle = candidate.Handle;
+				if (const uint64* entity = owners.Find(oldHandle)) range.Owner = *entity;
+
+				const TArray<uint32>& indices = candidate.Buffers.Indices;
+				for (int32 i = 0; i < indices.Num(); i += 3) {
+					merged.Indices.Add(baseVertex + indices[i]);
+					merged.Indices.Add(baseVertex + indices[mirrored ? i + 2 : i + 1]);
+					merged.Indices.Add(baseVertex + indices[mirrored ? i + 1 : i + 2]);
+				}
+
+				remapped.Add(oldHandle, MakeBatchHandle(batchId, batch.Ranges.Num() - 1));
+			}
+
+			batch.MeshId = meshSubsystem->CreateMesh(merged, 0, true);
+			batch.Indices = MoveTemp(merged.Indices);
+			if (batch.MeshId == INDEX_NONE) {
+				for (int32 i = start; i < end; ++i) remapped.Remove(candidates[i].Handle);
+				Batches.Remove(batchId);
+				start = end;
+				continue;
+			}
+
+			UStaticMeshComponent* component = NewObject<UStaticMeshComponent>(owner);
+			component->SetStaticMesh(meshSubsystem->Get(batch.MeshId));
+			component->SetupAttachment(owner->GetRootComponent());
+			component->SetMobility(EComponentMobility::Movable);
+			component->SetRelativeLocation(origin);
+			component->RegisterComponent();
+			component->SetMaterial(0, materialSubsystem->GetOrCreateMid(world, materialId));
+			materialSubsystem->Retain(materialId);
+			BatchComponents.Add(batchId, component);
+
+			for (int32 i = start; i < end; ++i) DestroyGroup(world, candidates[i].GroupId);
+			batchedObjects += end - start;
+			start = end;
+		}
+	}
+
+	if (batchedObjects > 0)
+		UE_LOG(LogTemp, Log, TEXT(">>> Batched %d single-instance objects into %d meshes"), batchedObjects, NextBatchId - firstBatchId);
+	return remapped;
+}
+
+bool UISMSubsystem::FindBatchRange(uint64 handle, int32& outBatchId, int32& outRangeIndex) const {
+	if (!IsBatchHandle(handle)) return false;
+	outBatchId = int32(uint32(handle >> 32) & GenerationMask);
+	outRangeIndex = int32(uint32(handle));
+	const ISMBatch* batch = Batches.Find(outBatchId);
+	return batch && batch->Ranges.IsValidIndex(outRangeIndex);
+}
+
+bool UISMSubsystem::FindBatchedObject(const UPrimitiveComponent* component, int32 faceIndex, uint64& outHandle, uint64& outOwner) const {
+	for (const TPair<int32, TObjectPtr<UStaticMeshComponent>>& batchComponent : BatchComponents) {
+		if (batchComponent.Value.Get() != component) continue;
+		const ISMBatch& batch = Batches[batchComponent.Key];
+		// Ranges are appended in triangle order
+		const int32 rangeIndex = Algo::UpperBoundBy(batch.Ranges, faceIndex, &ISMBatchRange::FirstTriangle) - 1;
+		if (!batch.Ranges.IsValidIndex(rangeIndex)) return false;
+		const ISMBatchRange& range = batch.Ranges[rangeIndex];
+		if (faceIndex >= range.FirstTriangle + range.NumTriangles) return false;
+		outHandle = MakeBatchHandle(batchComponent.Key, rangeIndex);
+		outOwner = range.Owner;
+		return true;
+	}
+	return false;
+}
+
+bool UISMSubsystem::GetBatchedRange(uint64 handle, UStaticMeshComponent*& outComponent, int32& outFirstTriangle, int32& outNumTriangles) const {
+	int32 batchId, rangeIndex;
+	if (!FindBatchRange(handle, batchId, rangeIndex)) return false;
+	const TObjectPtr<UStaticMeshComponent>* component = BatchComponents.Find(batchId);
+	if (!component) return false;
+	const ISMBatchRange& range = Batches[batchId].Ranges[rangeIndex];
+	outComponent = component->Get();
+	outFirstTriangle = range.FirstTriangle;
+	outNumTriangles = range.NumTriangles;
+	return true;
+}
+
+bool UISMSubsystem::SetBatchedObjectHidden(UWorld* world, uint64 handle, bool hidden) {
+	int32 batchId, rangeIndex;
+	if (!FindBatchRange(handle, batchId, rangeIndex)) return false;
+	ISMBatchRange& range = Batches[batchId].Ranges[rangeIndex];
+	if (range.Hidden == hidden) return true;
+	range.Hidden = hidden;
+	DirtyBatches.Add(batchId);
+	return true;
+}
+
+int32 UISMSubsystem::SetBatchedObjectsHidden(UWorld* world, TArrayView<const uint64> handles, TArrayView<const bool> hidden) {
+	check(handles.Num() == hidden.Num());
+	int32 changed = 0;
+	for (int32 i = 0; i < handles.Num(); ++i) {
+		int32 batchId, rangeIndex;
+		if (!FindBatchRange(handles[i], batchId, rangeIndex)) continue;
+		ISMBatchRange& range = Batches[batchId].Ranges[rangeIndex];
+		if (range.Hidden == hidden[i]) continue;
+		range.Hidden = hidden[i];
+		DirtyBatches.Add(batchId);
+		++changed;
+	}
+	return changed;
+}
+
+// Hidden ranges collapse to degenerate triangles in place, so face indices stay stable for picking and
+// the index count, sections and vertex data are untouched. Only the index buffer contents are uploaded.
+void UISMSubsystem::UploadBatchIndices(int32 batchId) {
+	const ISMBatch* batch = Batches.Find(batchId);
+	UStaticMesh* mesh = batch ? GetWorld()->GetSubsystem<UMeshSubsystem>()->Get(batch->MeshId) : nullptr;
+	FStaticMeshRenderData* renderData = mesh ? mesh->GetRenderData() : nullptr;
+	if (!renderData || renderData->LODResources.Num() == 0) return;
+	FRawStaticIndexBuffer* indexBuffer = &renderData->LODResources[0].IndexBuffer;
+	if (indexBuffer->GetNumIndices() != batch->Indices.Num()) return;
+
+	const int32 stride = indexBuffer->Is32Bit() ? sizeof(uint32) : sizeof(uint16);
+	TArray<uint8> data;
+	data.SetNumZeroed(batch->Indices.Num() * stride);
+	uint32* indices32 = reinterpret_cast<uint32*>(data.GetData());
+	uint16* indices16 = reinterpret_cast<uint16*>(data.GetData());
+	for (const ISMBatchRange& range : batch->Ranges) {
+		if (range.Hidden) continue;
+		const int32 end = (range.FirstTriangle + range.NumTriangles) * 3;
+		for (int32 i = range.FirstTriangle * 3; i < end; ++i) {
+			if (stride == sizeof(uint32)) indices32[i] = batch->Indices[i];
+			else indices16[i] = uint16(batch->Indices[i]);
+		}
+	}
+
+	// The mesh releases its resources through the render thread too, so the buffer outlives this command
+	ENQUEUE_RENDER_COMMAND(UploadBatchIndices)([indexBuffer, data = MoveTemp(data)](FRHICommandListImmediate& RHICmdList) {
+		if (!indexBuffer->IndexBufferRHI.IsValid()) return;
+		void* target = RHICmdList.LockBuffer(indexBuffer->IndexBufferRHI, 0, data.Num(), RLM_WriteOnly);
+		FMemory::Memcpy(target, data.GetData(), data.Num());
+		RHICmdList.UnlockBuffer(indexBuffer->IndexBufferRHI);
+	});
+}
+
+void UISMSubsystem::DestroyBatch(UWorld* world, int32 batchId) {
+	ISMBatch batch;
+	if (!Batches.RemoveAndCopyValue(batchId, batch)) return;
+	DirtyBatches.Remove(batchId);
+	if (UMeshSubsystem* meshSub = world->GetSubsystem<UMeshSubsystem>()) meshSub->Release(batch.MeshId, false);
+	if (UMaterialSubsystem* materialSub = world->GetSubsystem<UMaterialSubsystem>()) materialSub->Release(batch.MaterialId);
+	TObjectPtr<UStaticMeshComponent> component;
+	if (BatchComponents.RemoveAndCopyValue(batchId, component) && component) component->DestroyComponent();
+}
@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InternedString.h"
+#include "Misc/Crc.h"
+#include "Misc/ScopeRWLock.h"
+#include <atomic>
+
+namespace IFC {
+	// Fixed chunk table, so entries never move and ones a handle holds are read without the lock
+	constexpr uint32 CHUNK_BITS = 12;
+	constexpr uint32 CHUNK_SIZE = 1u << CHUNK_BITS;
+	constexpr uint32 MAX_CHUNKS = 4096;
+
+	struct InternEntry {
+		FString Value;
+		uint32 Hash = 0;
+		bool Live = false;
+		std::atomic<int32> RefCount{ 0 };
+	};
+
+	struct InternPool {
+		InternEntry* Chunks[MAX_CHUNKS] = {};
+		uint32 Count = 1; // Index 0 is the empty string
+		int32 Live = 0;
+		TArray<uint32> FreeList;
+		TMultiMap<uint32, uint32> ByHash; // Case-sensitive hash -> index
+		SIZE_T Bytes = 0;
+		FRWLock Lock;
+
+		InternPool() { Chunks[0] = new InternEntry[CHUNK_SIZE]; }
+
+		InternEntry& At(uint32 index) const { return Chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)]; }
+
+		uint32 Find(const FString& value, uint32 hash) const {
+			for (auto it = ByHash.CreateConstKeyIterator(hash); it; ++it)
+				if (At(it.Value()).Value.Equals(value, ESearchCase::CaseSensitive))
+					return it.Value();
+			return 0;
+		}
+
+		// A found entry whose count already dropped to zero is revived; its pending Release sees that and keeps it
+		uint32 Intern(const FString& value) {
+			if (value.IsEmpty())
+				return 0;
+			const uint32 hash = FCrc::StrCrc32(*value);
+			{
+				FReadScopeLock readLock(Lock);
+				if (const uint32 index = Find(value, hash)) {
+					At(index).RefCount.fetch_add(1, std::memory_order_relaxed);
+					return index;
+				}
+			}
+			FWriteScopeLock writeLock(Lock);
+			if (const uint32 index = Find(value, hash)) {
+				At(index).RefCount.fetch_add(1, std::memory_order_relaxed);
+				return index;
+			}
+			uint32 index;
+			if (FreeList.Num() > 0) {
+				index = FreeList.Pop();
+			} else {
+				index = Count++;
+				check((index >> CHUNK_BITS) < MAX_CHUNKS);
+				InternEntry*& chunk = Chunks[index >> CHUNK_BITS];
+				if (!chunk)
+					chunk = new InternEntry[CHUNK_SIZE];
+			}
+			InternEntry& entry = At(index);
+			entry.Value = value;
+			entry.Hash = hash;
+			entry.Live = true;
+			entry.RefCount.store(1, std::memory_order_relaxed);
+			ByHash.Add(hash, index);
+			Bytes += entry.Value.GetAllocatedSize();
+			++Live;
+			return index;
+		}
+
+		void Retain(uint32 index) {
+			if (index != 0)
+				At(index).RefCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void Release(uint32 index) {
+			if (index == 0 || At(index).RefCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			FWriteScopeLock writeLock(Lock);
+			InternEntry& entry = At(index);
+			// Interned again, or already freed by an earlier release, while waiting for the lock
+			if (!entry.Live || entry.RefCount.load(std::memory_order_relaxed) != 0)
+				return;
+			ByHash.RemoveSingle(entry.Hash, index);
+			Bytes -= FMath::Min(Bytes, entry.Value.GetAllocatedSize());
+			entry.Value.Empty();
+			entry.Live = false;
+			FreeList.Add(index);
+			--Live;
+		}
+	};
+
+	InternPool& GetPool() {
+		static InternPool* pool = new InternPool(); // Never destroyed, handles may outlive static destruction
+		return *pool;
+	}
+
+	InternedString::InternedString(const FString& value)
+		: Index(GetPool().Intern(value)) {}
+
+	InternedString::InternedString(const InternedString& other)
+		: Index(other.Index) {
+		GetPool().Retain(Index);
+	}
+
+	InternedString& InternedString::operator=(const InternedString& other) {
+		GetPool().Retain(other.Index);
+		GetPool().Release(Index);
+		Index = other.Index;
+		return *this;
+	}
+
+	InternedString& InternedString::operator=(InternedString&& other) {
+		if (this != &other) {
+			GetPool().Release(Index);
+			Index = other.Index;
+			other.Index = 0;
+		}
+		return *this;
+	}
+
+	InternedString::~InternedString() {
+		GetPool().Release(Index);
+	}
+
+	const FString& InternedString::ToString() const {
+		return GetPool().At(Index).Value;
+	}
+
+	void InternedString::GetPoolStats(int32& outCount, SIZE_T& outBytes) {
+		InternPool& pool = GetPool();
+		FReadScopeLock readLock(pool.Lock);
+		outCount = pool.Live;
+		outBytes = pool.Bytes;
+	}
+
+	void InternedString::Register(flecs::world& world) {
+		world.component<InternedString>()
+			.opaque(flecs::String)
+			.serialize([](const flecs::serializer* serializer, const InternedString* data) {
+			const FTCHARToUTF8 utf8(**data);
+			const char* value = utf8.Get();
+			return serializer->value(flecs::String, &value);
+		})
+			.assign_string([](InternedString* data, const char* value) {
+			*data = InternedString(FString(UTF8_TO_TCHAR(value)));
+		});
+	}
+}
@@ -2,6 +2,9 @@
 
 #include "LayerFeature.h"
 #include "IFC.h"
+#include "ModelFeature.h"
+#include "VisibilityFeature.h"
+#include "StreamingFeature.h"
 #include "Assets.h"
 #include "ECS.h"
 #include "rapidjson/document.h"
@@ -11,13 +14,13 @@ namespace IFC {
 	void LayerFeature::CreateComponents(flecs::world& world) {
 		using namespace ECS;
 		world.component<Layer>();
-		world.component<Path>().member<FString>(VALUE);
+		world.component<Path>().member<InternedString>(VALUE);
 		world.component<IfcxVersion>().member<FString>(VALUE);
 		world.component<DataVersion>().member<FString>(VALUE);
 		world.component<Author>().member<FString>(VALUE);
 		world.component<Timestamp>().member<FString>(VALUE);
 
-		world.component<Owner>().member<FString>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
+		world.component<Owner>().member<InternedString>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
 	}
 
 	void LayerFeature::CreateQueries(flecs::world& world) {
@@ -39,7 +42,11 @@ namespace IFC {
 		return prefix + UTF8_TO_TCHAR(OWNER) + suffix;
 	}
 
-	FString ParseLayer(const rapidjson::Value& header, const FString path, const TArray<FString>& components) {
+	InternedString GetLayerOwner(flecs::entity layer) {
+		return InternedString(UTF8_TO_TCHAR(layer.path(".", "").c_str()));
+	}
+
+	FString ParseLayer(const JsonValue& header, const FString path, const TArray<FString>& components) {
 		FString layer = IFC::Scope() + "." + IFC::MakeId(FGuid::NewGuid().ToString(EGuidFormats::DigitsWithHyphens));
 
 		FString result = FString::Printf(TEXT("%s {\n"), *layer);
@@ -69,15 +76,16 @@ namespace IFC {
 	void AddLayers(flecs::world& world, const TArray<FString>& paths, const TArray<FString>& components) {
 		if (paths.Num() < 1) return;
 
-		rapidjson::Document tempDoc;
-		rapidjson::Document::AllocatorType& allocator = tempDoc.GetAllocator();
-		rapidjson::Value combinedData(rapidjson::kArrayType);
+		JsonDocument tempDoc;
+		JsonDocument::AllocatorType& allocator = tempDoc.GetAllocator();
+		JsonValue combinedData(rapidjson::kArrayType);
 		FString code;
 
 		for (const FString& path : paths) {
+			const InternedString internedPath(path);
 			bool exists = false;
-			world.try_get<QueryLayers>()->Value.each([&path, &exists](flecs::entity layer) {
-				if (layer.try_get<Path>()->Value == path) {
+			world.try_get<QueryLayers>()->Value.each([&internedPath, &exists](flecs::entity layer) {
+				if (layer.try_get<Path>()->Value == internedPath) {
 					exists = true;
 					return;
 				}
@@ -88,7 +96,7 @@ namespace IFC {
 
 			auto jsonString = Assets::LoadTextFile(path);
 
-			rapidjson::Document doc;
+			JsonDocument doc;
 			if (doc.Parse(jsonString).HasParseError()) {
 				free(jsonString);
 				UE_LOG(LogTemp, Error, TEXT(">>> Parse error in file %s: %s"), *path, *FString(GetParseError_En(doc.GetParseError())));
@@ -112,6 +120,48 @@ namespace IFC {
 		ECS::RunCode(world, paths[0], code);
 	}
 
+	void RemoveLayers(flecs::world& world, const TArray<flecs::entity>& layers) {
+		if (layers.Num() < 1) return;
+
+		// Owner prefabs hold their layer's path; exact, so layer "A" never matches "AB"
+		TSet<InternedString> layerOwners;
+		for (const flecs::entity layer : layers)
+			layerOwners.Add(GetLayerOwner(layer));
+		TArray<flecs::entity> owners;
+		world.query_builder<const Owner>()
+			.with(flecs::Prefab)
+			.build()
+			.each([&](flecs::entity owner, const Owner& value) {
+			if (owner.owns<Owner>() && layerOwners.Contains(value.Value))
+				owners.Add(owner);
+		});
+
+		// Objects, prefab children and attributes of the layer; instance subtrees go with their roots
+		TArray<flecs::entity> entities;
+		for (const flecs::entity owner : owners)
+			world.query_builder<>()
+				.with(flecs::IsA, owner)
+				.with(flecs::Prefab).optional()
+				.build()
+				.each([&](flecs::entity entity) { entities.Add(entity); });
+
+		world.add<Unloading>();
+		ReleaseModelResources(world, entities);
+		world.defer_begin();
+		for (flecs::entity entity : entities)
+			entity.destruct();
+		for (flecs::entity owner : owners)
+			owner.destruct();
+		for (flecs::entity layer : layers)
+			layer.destruct();
+		world.defer_end();
+		world.remove<Unloading>();
+		PruneStreamingCells(world);
+		RemoveVisibilityCategories(world, layers);
+
+		UE_LOG(LogTemp, Log, TEXT(">>> Removed %d layers, %d entities"), layers.Num(), entities.Num());
+	}
+
 	FString CleanLayerName(const FString& id) {
 		FString clean = id;
 		// Remove everything before the last "/"
@@ -1,81 +1,248 @@
 #include "MaterialSubsystem.h"
 #include "Engine/World.h"
 #include "Materials/MaterialInstanceDynamic.h"
+#include "Materials/MaterialParameterCollection.h"
+#include "Materials/MaterialParameterCollectionInstance.h"
 #include "HAL/PlatformTime.h"
 #include "Hash/CityHash.h"
+#include "SharedResourceCache.h"
+#include "MemoryTags.h"
 
 static const FName baseColorParameter("Base Color");
 static const FName offsetParameter("Offset");
+static const FName hiddenMaskParameter("HiddenMask");
 
-uint64 UMaterialSubsystem::MakeHash(UMaterialInterface* master, const FVector4f& rgba, bool opaque) {
+// Every parameter written to the material is part of the key
+uint64 UMaterialSubsystem::MakeHash(UMaterialInterface* master, const FVector4f& rgba, float offset, bool opaque) {
 	uint64 h = 1469598103934665603ull;
 	h ^= reinterpret_cast<uint64>(master) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
 	h ^= (opaque ? 1ull : 0ull) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
 	const uint64 colorHash = CityHash64(reinterpret_cast<const char*>(&rgba), sizeof(FVector4f));
 	h ^= colorHash + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+	// +0.0f folds -0 into 0
+	h ^= uint64(GetTypeHash(offset + 0.0f)) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
 	return h;
 }
 
-int32 UMaterialSubsystem::CreateMaterial(UWorld* world, const FVector4f& rgba, float offset) {
+FVector4f UMaterialSubsystem::Quantize(const FVector4f& rgba) const {
+	if (!Palette.Enabled) return rgba;
+	const float steps = float(FMath::Max(Palette.Levels, 2) - 1);
+	auto snap = [steps](float value) { return FMath::RoundToFloat(FMath::Clamp(value, 0.0f, 1.0f) * steps) / steps; };
+	return FVector4f(snap(rgba.X), snap(rgba.Y), snap(rgba.Z), snap(rgba.W));
+}
+
+void UMaterialSubsystem::SetPalette(const MaterialPaletteSettings& settings) {
+	Palette = settings;
+	RequestedColors.Reset();
+	CreatedMaterials = 0;
+}
+
+int32 UMaterialSubsystem::CreateMaterial(UWorld* world, const FVector4f& requested, float offset, int32 reservedId) {
+	LLM_SCOPE_BYTAG(IFC_Materials);
+	RequestedColors.Add(MakeHash(nullptr, requested, offset, true));
+	// The snapped color is also what the material gets, so sharing does not depend on which color came first
+	const FVector4f rgba = Quantize(requested);
 	const bool opaque = rgba.W > 0.99f;
-	UMaterialInterface* master = opaque ? MOpaque : MTranslucent;
-	const uint64 h = MakeHash(master, rgba, opaque);
+	UMaterialInterface* master = InstancedColors ? GetInstancedMaster(opaque) : opaque ? MOpaque.Get() : MTranslucent.Get();
+	const uint64 h = MakeHash(master, rgba, offset, opaque);
 	if (const int32* found = HashToId.Find(h)) {
+		if (reservedId != INDEX_NONE) EntryData.Cancel(reservedId);
 		Retain(*found);
 		return *found;
 	}
-	UMaterialInstanceDynamic* mid = UMaterialInstanceDynamic::Create(master, world);
-	mid->SetVectorParameterValue(baseColorParameter, FLinearColor(rgba.X, rgba.Y, rgba.Z, rgba.W));
-	mid->SetScalarParameterValue(offsetParameter, offset);
-	return Register(mid, h);
-}
-
-int32 UMaterialSubsystem::Register(UMaterialInstanceDynamic* mid, uint64 contentHash) {
-	if (!mid) return INDEX_NONE;
-	if (contentHash != 0) {
-		if (const int32* found = HashToId.Find(contentHash)) {
-			MaterialEntryData* entry = EntryData.Find(*found);
-			if (!entry) return INDEX_NONE;
-			++entry->RefCount;
-			entry->LastAccess = FPlatformTime::Seconds();
-			return *found;
-		}
+	if (InstancedColors) {
+		const int32 newId = reservedId != INDEX_NONE ? reservedId : EntryData.Reserve();
+		MaterialEntryData& data = EntryData.Commit(newId, MaterialEntryData());
+		data.RefCount = 1;
+		data.ContentHash = h;
+		data.LastAccess = FPlatformTime::Seconds();
+		data.Bytes = sizeof(MaterialInstanceData);
+		data.Instanced = true;
+		data.Instance = { rgba, offset, opaque };
+		TotalBytes += data.Bytes;
+		HashToId.Add(h, newId);
+		++CreatedMaterials;
+		return newId;
+	}
+	// Another world may have created it already; new ones are outered to the shared cache, not the world
+	USharedResourceCache* shared = USharedResourceCache::Get();
+	UMaterialInstanceDynamic* mid = shared ? shared->FindMaterial(h) : nullptr;
+	if (!mid) {
+		mid = UMaterialInstanceDynamic::Create(master, shared ? static_cast<UObject*>(shared) : world);
+		mid->SetVectorParameterValue(baseColorParameter, FLinearColor(rgba.X, rgba.Y, rgba.Z, rgba.W));
+		mid->SetScalarParameterValue(offsetParameter, offset);
+	}
+	const int32 newId = Register(mid, h, reservedId);
+	if (newId != INDEX_NONE) ++CreatedMaterials;
+	return newId;
+}
+
+bool UMaterialSubsystem::ReleaseShared(const MaterialEntryData& entry) {
+	if (!entry.Shared) return true;
+	USharedResourceCache* shared = USharedResourceCache::Get();
+	return !shared || shared->RemoveMaterialHolder(entry.ContentHash, GetWorld());
+}
+
+void UMaterialSubsystem::Deinitialize() {
+	EntryData.ForEach([this](int32, const MaterialEntryData& entry) { ReleaseShared(entry); });
+	Super::Deinitialize();
+}
+
+TObjectPtr<UMaterialInstanceDynamic>& UMaterialSubsystem::MidSlot(int32 id) {
+	const int32 index = TSlotMap<MaterialEntryData>::IndexOf(id);
+	if (index >= Materials.Num()) Materials.SetNum(index + 1);
+	return Materials[index];
+}
+
+int32 UMaterialSubsystem::Register(UMaterialInstanceDynamic* mid, uint64 contentHash, int32 reservedId) {
+	const int32* found = mid && contentHash != 0 ? HashToId.Find(contentHash) : nullptr;
+	if (!mid || found) {
+		if (reservedId != INDEX_NONE) EntryData.Cancel(reservedId);
+		if (!found || !EntryData.Contains(*found)) return INDEX_NONE;
+		Retain(*found);
+		return *found;
 	}
-	const int32 newId = NextId++;
-	Materials.Add(newId, mid);
-	MaterialEntryData& data = EntryData.Add(newId);
+	const int32 newId = reservedId != INDEX_NONE ? reservedId : EntryData.Reserve();
+	MaterialEntryData& data = EntryData.Commit(newId, MaterialEntryData());
+	MidSlot(newId) = mid;
+	++MidCount;
+	if (USharedResourceCache* shared = USharedResourceCache::Get())
+		data.Shared = shared->AddMaterialHolder(contentHash, mid, GetWorld());
 	data.RefCount = 1;
 	data.ContentHash = contentHash;
 	data.LastAccess = FPlatformTime::Seconds();
+	data.Bytes = mid->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+	TotalBytes += data.Bytes;
 	if (contentHash != 0) HashToId.Add(contentHash, newId);
+	TrimCache(CacheBudget);
 	return newId;
 }
 
 void UMaterialSubsystem::Retain(int32 id) {
 	MaterialEntryData* entry = EntryData.Find(id);
 	if (!entry) return;
-	++entry->RefCount;
+	if (entry->RefCount++ == 0) Uncache(id);
 	entry->LastAccess = FPlatformTime::Seconds();
 }
 
+void UMaterialSubsystem::Cache(int32 id) {
+	Cached.PushBack(EntryData, id);
+	CachedBytes += EntryData[id].Bytes;
+}
+
+void UMaterialSubsystem::Uncache(int32 id) {
+	MaterialEntryData* entry = EntryData.Find(id);
+	if (!entry || !entry->Lru.Linked) return;
+	Cached.Remove(EntryData, id);
+	CachedBytes -= FMath::Min(CachedBytes, entry->Bytes);
+}
+
 void UMaterialSubsystem::Release(int32 id) {
+	if (ReleaseReference(id)) TrimCache(CacheBudget);
+}
+
+void UMaterialSubsystem::ReleaseMany(TArrayView<const int32> ids) {
+	bool trim = false;
+	for (int32 id : ids) trim |= ReleaseReference(id);
+	if (trim) TrimCache(CacheBudget);
+}
+
+bool UMaterialSubsystem::ReleaseReference(int32 id) {
 	MaterialEntryData* entry = EntryData.Find(id);
-	if (!entry) return;
+	if (!entry || entry->RefCount <= 0) return false;
 	--entry->RefCount;
-	if (entry->RefCount > 0) {
-		entry->LastAccess = FPlatformTime::Seconds();
-		return;
+	entry->LastAccess = FPlatformTime::Seconds();
+	if (entry->RefCount > 0) return false;
+	if (entry->ContentHash == 0) {
+		Evict(id);
+		return false;
+	}
+	Cache(id);
+	return true;
+}
+
+int32 UMaterialSubsystem::MarkPendingGarbage(double budgetSeconds) {
+	const double deadline = FPlatformTime::Seconds() + budgetSeconds;
+	int32 marked = 0;
+	while (PendingGarbage.Num() > 0 && (marked == 0 || FPlatformTime::Seconds() < deadline)) {
+		if (TObjectPtr<UMaterialInstanceDynamic> mid = PendingGarbage.Pop()) mid->MarkAsGarbage();
+		++marked;
+	}
+	return marked;
+}
+
+void UMaterialSubsystem::Evict(int32 id) {
+	Uncache(id);
+	MaterialEntryData entry;
+	if (!EntryData.Remove(id, &entry)) return;
+	TotalBytes -= FMath::Min(TotalBytes, entry.Bytes);
+	TObjectPtr<UMaterialInstanceDynamic> mid = MidSlot(id);
+	MidSlot(id) = nullptr;
+	if (mid) --MidCount;
+	if (entry.ContentHash != 0) HashToId.Remove(entry.ContentHash);
+	// MIDs other worlds still use are left to them
+	if (ReleaseShared(entry) && mid) PendingGarbage.Add(mid);
+}
+
+void UMaterialSubsystem::SetCacheBudget(SIZE_T bytes) {
+	CacheBudget = bytes;
+	TrimCache(CacheBudget);
+}
+
+void UMaterialSubsystem::TrimCache(SIZE_T budget) {
+	while (CachedBytes > budget && Cached.Front() != INDEX_NONE) Evict(Cached.Front());
+}
+
+MaterialStats UMaterialSubsystem::GetStats() const {
+	MaterialStats stats;
+	stats.Count = EntryData.Num();
+	EntryData.ForEach([&](int32, const MaterialEntryData& entry) { stats.TotalRefCount += entry.RefCount; });
+	stats.CachedCount = Cached.Num();
+	stats.Bytes = TotalBytes;
+	stats.CachedBytes = CachedBytes;
+	stats.MidCount = MidCount;
+	stats.DistinctColors = RequestedColors.Num();
+	stats.CreatedMaterials = CreatedMaterials;
+	return stats;
+}
+
+bool UMaterialSubsystem::SetInstancedColors(bool enabled) {
+	if (enabled && (!MInstancedOpaque || !MInstancedTranslucent)) {
+		UE_LOG(LogTemp, Warning, TEXT(">>> Instanced color masters not found, falling back to one material per color"));
+		InstancedColors = false;
+		return false;
 	}
-	const uint64 hash = entry->ContentHash;
-	EntryData.Remove(id);
-	UMaterialInstanceDynamic* mid = nullptr;
-	if (const TObjectPtr<UMaterialInstanceDynamic>* ptr = Materials.Find(id)) mid = ptr->Get();
-	Materials.Remove(id);
-	if (hash != 0) HashToId.Remove(hash);
-	if (mid) mid->MarkAsGarbage();
+	InstancedColors = enabled;
+	return true;
+}
+
+bool UMaterialSubsystem::SetHiddenMask(UWorld* world, uint32 mask) {
+	if (!MVisibility) return false;
+	UMaterialParameterCollectionInstance* instance = world->GetParameterCollectionInstance(MVisibility);
+	return instance && instance->SetScalarParameterValue(hiddenMaskParameter, float(mask));
+}
+
+UMaterialInstanceDynamic* UMaterialSubsystem::GetOrCreateMid(UWorld* world, int32 id) {
+	if (UMaterialInstanceDynamic* mid = Get(id)) return mid;
+	LLM_SCOPE_BYTAG(IFC_Materials);
+	MaterialEntryData* entry = EntryData.Find(id);
+	if (!entry || !entry->Instanced) return nullptr;
+	const MaterialInstanceData* data = &entry->Instance;
+
+	UMaterialInstanceDynamic* mid = UMaterialInstanceDynamic::Create(data->Opaque ? MOpaque : MTranslucent, world);
+	mid->SetVectorParameterValue(baseColorParameter, FLinearColor(data->Color.X, data->Color.Y, data->Color.Z, data->Color.W));
+	mid->SetScalarParameterValue(offsetParameter, data->Offset);
+	MidSlot(id) = mid;
+	++MidCount;
+	const SIZE_T bytes = mid->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+	entry->Bytes += bytes;
+	TotalBytes += bytes;
+	if (entry->Lru.Linked) CachedBytes += bytes;
+	return mid;
 }
 
 UMaterialInstanceDynamic* UMaterialSubsystem::Get(int32 id) const {
-	const TObjectPtr<UMaterialInstanceDynamic>* ptr = Materials.Find(id);
-	return ptr ? ptr->Get() : nullptr;
+	if (!EntryData.Contains(id)) return nullptr;
+	const int32 index = TSlotMap<MaterialEntryData>::IndexOf(id);
+	return Materials.IsValidIndex(index) ? Materials[index].Get() : nullptr;
 }
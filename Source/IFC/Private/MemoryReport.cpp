@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MemoryReport.h"
+#include "IFC.h"
+#include "LayerFeature.h"
+#include "AttributeFeature.h"
+#include "ModelFeature.h"
+#include "HAL/IConsoleManager.h"
+
+LLM_DEFINE_TAG(IFC_Json);
+LLM_DEFINE_TAG(IFC_Script);
+LLM_DEFINE_TAG(IFC_Entities);
+LLM_DEFINE_TAG(IFC_Meshes);
+LLM_DEFINE_TAG(IFC_Materials);
+LLM_DEFINE_TAG(IFC_Instances);
+
+namespace IFC {
+	TArray<flecs::world_t*>& ReportWorlds() {
+		static TArray<flecs::world_t*> worlds;
+		return worlds;
+	}
+
+	FAutoConsoleCommandWithWorld MemoryReportCommand(
+		TEXT("IFC.Memory.Report"),
+		TEXT("Logs IFC memory of the current world by layer, string component and instance group."),
+		FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* uWorld) {
+		for (flecs::world_t* registered : ReportWorlds()) {
+			flecs::world world(registered);
+			if (world.get_ctx() == uWorld)
+				LogMemoryReport(world);
+		}
+	}));
+
+	void RegisterMemoryReport(flecs::world& world) {
+		ReportWorlds().AddUnique(world.c_ptr());
+		world.atfini([](flecs::world_t* finished, void*) { ReportWorlds().Remove(finished); });
+	}
+
+	template <typename T>
+	SIZE_T OwnedStringBytes(flecs::entity entity) {
+		return entity.owns<T>() ? sizeof(T) : 0;
+	}
+
+	template <typename T>
+	void AddComponentMemory(flecs::world& world, const TCHAR* name, MemoryReport& report) {
+		ComponentMemory& memory = report.Components.Add_GetRef({ name });
+		world.query_builder<const T>()
+			.term_at(0).self()
+			.with(flecs::Prefab).optional()
+			.build()
+			.each([&memory](const T&) {
+			++memory.Count;
+			memory.Bytes += sizeof(T);
+		});
+	}
+
+	MemoryReport GetMemoryReport(flecs::world& world) {
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		UMeshSubsystem* meshSubsystem = uWorld->GetSubsystem<UMeshSubsystem>();
+		UMaterialSubsystem* materialSubsystem = uWorld->GetSubsystem<UMaterialSubsystem>();
+		MemoryReport report;
+		report.Meshes = meshSubsystem->GetStats();
+		report.Materials = materialSubsystem->GetStats();
+		report.Groups = uWorld->GetSubsystem<UISMSubsystem>()->GetGroupMemory();
+		report.Groups.Sort([](const ISMGroupMemory& a, const ISMGroupMemory& b) { return a.Bytes > b.Bytes; });
+
+		AddComponentMemory<Id>(world, TEXT("Id"), report);
+		AddComponentMemory<Name>(world, TEXT("Name"), report);
+		AddComponentMemory<Value>(world, TEXT("Value"), report);
+		AddComponentMemory<Owner>(world, TEXT("Owner"), report);
+		AddComponentMemory<Path>(world, TEXT("Path"), report);
+		InternedString::GetPoolStats(report.InternedStrings, report.InternedBytes);
+
+		// Entities belong to the layer whose GetLayerOwner equals their inherited Owner, as in RemoveLayers
+		TMap<InternedString, int32> ownerLayers;
+		world.try_get<QueryLayers>()->Value.each([&](flecs::entity layer) {
+			ownerLayers.Add(GetLayerOwner(layer), report.Layers.Num());
+			report.Layers.Add_GetRef({}).Layer = UTF8_TO_TCHAR(layer.name().c_str());
+		});
+		TArray<TSet<int32>> meshes, materials;
+		meshes.SetNum(report.Layers.Num());
+		materials.SetNum(report.Layers.Num());
+		world.query_builder<const Owner>()
+			.with(flecs::Prefab).optional()
+			.build()
+			.each([&](flecs::entity entity, const Owner& owner) {
+			const int32* found = ownerLayers.Find(owner.Value);
+			if (!found)
+				return;
+			const int32 index = *found;
+			LayerMemory& layer = report.Layers[index];
+			++layer.Entities;
+			layer.StringBytes += OwnedStringBytes<Id>(entity) + OwnedStringBytes<Name>(entity)
+				+ OwnedStringBytes<Value>(entity) + OwnedStringBytes<Owner>(entity);
+			if (entity.owns<Mesh>())
+				meshes[index].Add(entity.try_get<Mesh>()->Value);
+			if (entity.owns<Material>())
+				materials[index].Add(entity.try_get<Material>()->Value);
+			if (entity.owns<ISM>())
+				++layer.Instances;
+		});
+
+		for (int32 i = 0; i < report.Layers.Num(); ++i) {
+			LayerMemory& layer = report.Layers[i];
+			layer.Meshes = meshes[i].Num();
+			for (int32 meshId : meshes[i])
+				if (const MeshEntryData* entry = meshSubsystem->FindEntry(meshId))
+					layer.MeshBytes += entry->Bytes;
+			layer.Materials = materials[i].Num();
+			for (int32 materialId : materials[i])
+				if (const MaterialEntryData* entry = materialSubsystem->FindEntry(materialId))
+					layer.MaterialBytes += entry->Bytes;
+		}
+		return report;
+	}
+
+	void LogMemoryReport(flecs::world& world, int32 maxGroups) {
+		const MemoryReport report = GetMemoryReport(world);
+		constexpr double MB = 1024.0 * 1024.0;
+		UE_LOG(LogTemp, Log, TEXT(">>> Memory: %d meshes %.2f MB (%.2f MB cached), %d materials %.2f MB (%.2f MB cached)"),
+			report.Meshes.Count, report.Meshes.Bytes / MB, report.Meshes.CachedBytes / MB,
+			report.Materials.Count, report.Materials.Bytes / MB, report.Materials.CachedBytes / MB);
+		UE_LOG(LogTemp, Log, TEXT(">>> Interned strings: %d, %.2f MB"), report.InternedStrings, report.InternedBytes / MB);
+		for (const LayerMemory& layer : report.Layers)
+			UE_LOG(LogTemp, Log, TEXT(">>> Layer %s: %d entities, strings %.2f MB, %d meshes %.2f MB, %d materials %.2f MB, %d instances"),
+				*layer.Layer, layer.Entities, layer.StringBytes / MB, layer.Meshes, layer.MeshBytes / MB,
+				layer.Materials, layer.MaterialBytes / MB, layer.Instances);
+		for (const ComponentMemory& component : report.Components)
+			UE_LOG(LogTemp, Log, TEXT(">>> Component %s: %d, %.2f MB"), *component.Component, component.Count, component.Bytes / MB);
+		for (int32 i = 0; i < report.Groups.Num() && i < maxGroups; ++i) {
+			const ISMGroupMemory& group = report.Groups[i];
+			UE_LOG(LogTemp, Log, TEXT(">>> Group mesh %d material %d: %d instances, %.2f MB"),
+				group.MeshId, group.MaterialKey, group.Instances, group.Bytes / MB);
+		}
+	}
+}
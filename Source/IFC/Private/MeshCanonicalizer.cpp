@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MeshCanonicalizer.h"
+#include "Algo/Sort.h"
+
+namespace {
+    // Cyclic Jacobi rotations on a symmetric 3x3 matrix. Columns of vectors are the eigenvectors.
+    void SymmetricEigen(double a[3][3], double values[3], FVector3d vectors[3]) {
+        double v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+        for (int32 sweep = 0; sweep < 32; ++sweep) {
+            const double offDiagonal = FMath::Abs(a[0][1]) + FMath::Abs(a[0][2]) + FMath::Abs(a[1][2]);
+            if (offDiagonal < 1e-12 * (FMath::Abs(a[0][0]) + FMath::Abs(a[1][1]) + FMath::Abs(a[2][2]) + 1e-30)) break;
+
+            for (int32 p = 0; p < 2; ++p)
+                for (int32 q = p + 1; q < 3; ++q) {
+                    if (a[p][q] == 0.0) continue;
+                    const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                    const double t = (theta >= 0.0 ? 1.0 : -1.0) / (FMath::Abs(theta) + FMath::Sqrt(theta * theta + 1.0));
+                    const double c = 1.0 / FMath::Sqrt(t * t + 1.0);
+                    const double s = t * c;
+                    for (int32 k = 0; k < 3; ++k) {
+                        const double akp = a[k][p], akq = a[k][q];
+                        a[k][p] = c * akp - s * akq;
+                        a[k][q] = s * akp + c * akq;
+                    }
+                    for (int32 k = 0; k < 3; ++k) {
+                        const double apk = a[p][k], aqk = a[q][k];
+                        a[p][k] = c * apk - s * aqk;
+                        a[q][k] = s * apk + c * aqk;
+                    }
+                    for (int32 k = 0; k < 3; ++k) {
+                        const double vkp = v[k][p], vkq = v[k][q];
+                        v[k][p] = c * vkp - s * vkq;
+                        v[k][q] = s * vkp + c * vkq;
+                    }
+                }
+        }
+        for (int32 i = 0; i < 3; ++i) {
+            values[i] = a[i][i];
+            vectors[i] = FVector3d(v[0][i], v[1][i], v[2][i]);
+        }
+    }
+
+    FVector3f Snap(const FVector3d& p, double tolerance) {
+        return FVector3f(
+            float(FMath::RoundToDouble(p.X / tolerance) * tolerance),
+            float(FMath::RoundToDouble(p.Y / tolerance) * tolerance),
+            float(FMath::RoundToDouble(p.Z / tolerance) * tolerance));
+    }
+}
+
+bool MeshCanonicalizer::Canonicalize(TArray<FVector3f>& points, const MeshCanonicalizationSettings& settings, FTransform& outFrame) {
+    outFrame = FTransform::Identity;
+    if (points.Num() == 0) return false;
+    const double tolerance = FMath::Max(double(settings.Tolerance), 1e-6);
+
+    FVector3d centroid = FVector3d::ZeroVector;
+    for (const FVector3f& p : points) centroid += FVector3d(p);
+    centroid /= double(points.Num());
+    // Snapping the frame origin keeps copies whose centroids differ by float noise on the same grid
+    centroid = FVector3d(Snap(centroid, tolerance));
+
+    double covariance[3][3] = {};
+    for (const FVector3f& p : points) {
+        const FVector3d d = FVector3d(p) - centroid;
+        for (int32 r = 0; r < 3; ++r)
+            for (int32 c = 0; c < 3; ++c) covariance[r][c] += d[r] * d[c];
+    }
+
+    double values[3];
+    FVector3d axes[3];
+    SymmetricEigen(covariance, values, axes);
+    int32 order[3] = { 0, 1, 2 };
+    Algo::Sort(order, [&](int32 a, int32 b) { return values[a] > values[b]; });
+
+    // Distinct variances make the axes unique up to sign; the sign comes from the third moment
+    bool rotated = values[order[0]] > 0.0;
+    const double scale = FMath::Max(values[order[0]], 1e-30);
+    rotated &= (values[order[0]] - values[order[1]]) / scale > settings.AxisTolerance;
+    rotated &= (values[order[1]] - values[order[2]]) / scale > settings.AxisTolerance;
+
+    FVector3d frame[3] = { axes[order[0]], axes[order[1]], axes[order[2]] };
+    for (int32 k = 0; k < 2 && rotated; ++k) {
+        double skew = 0.0, magnitude = 0.0;
+        for (const FVector3f& p : points) {
+            const double d = FVector3d::DotProduct(FVector3d(p) - centroid, frame[k]);
+            skew += d * d * d;
+            magnitude += FMath::Abs(d * d * d);
+        }
+        if (FMath::Abs(skew) <= settings.AxisTolerance * magnitude) rotated = false;
+        else if (skew < 0.0) frame[k] = -frame[k];
+    }
+
+    FMatrix rotation = FMatrix::Identity;
+    if (rotated) {
+        frame[2] = FVector3d::CrossProduct(frame[0], frame[1]).GetSafeNormal();
+        rotation = FMatrix(frame[0], frame[1], frame[2], FVector3d::ZeroVector);
+    }
+
+    for (FVector3f& p : points) {
+        const FVector3d d = FVector3d(p) - centroid;
+        const FVector3d local = rotated
+            ? FVector3d(FVector3d::DotProduct(d, frame[0]), FVector3d::DotProduct(d, frame[1]), FVector3d::DotProduct(d, frame[2]))
+            : d;
+        p = Snap(local, tolerance);
+    }
+
+    outFrame = FTransform(rotation.ToQuat(), centroid);
+    return rotated;
+}
@@ -0,0 +1,226 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MeshDiskCache.h"
+#include "EngineDefines.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace {
+    constexpr uint32 CacheMagic = 0x4D434649; // "IFCM"
+    constexpr uint32 CacheFormatVersion = 1;
+    const TCHAR* CacheExtension = TEXT(".mesh");
+
+    struct CacheHeader {
+        uint32 Magic;
+        uint32 FormatVersion;
+        uint32 SettingsVersion;
+        int32 NumLods;
+        uint64 ContentHash;
+    };
+
+    struct CacheLodHeader {
+        int32 NumVertices;
+        int32 NumIndices;
+    };
+
+    // One vertex and one triangle, the smallest LOD a valid entry can hold
+    constexpr int64 MinLodBytes = sizeof(CacheLodHeader) + sizeof(FVector3f) * 2 + sizeof(FVector2f) + sizeof(uint32) * 3;
+
+    // Arrays are read from the file straight into their final allocation
+    struct CacheReader {
+        FArchive& Archive;
+        int64 Size;
+
+        bool Read(void* out, int64 bytes) {
+            if (bytes < 0 || Archive.Tell() + bytes > Size) return false;
+            Archive.Serialize(out, bytes);
+            return !Archive.IsError();
+        }
+
+        template <typename T>
+        bool ReadArray(TArray<T>& out, int32 num) {
+            // Checked before allocating, so a corrupt count cannot request a huge buffer
+            if (Archive.Tell() + int64(num) * sizeof(T) > Size) return false;
+            out.SetNumUninitialized(num);
+            return Read(out.GetData(), int64(num) * sizeof(T));
+        }
+    };
+
+    template <typename T>
+    void WriteArray(TArray<uint8>& out, const TArray<T>& values) {
+        out.Append(reinterpret_cast<const uint8*>(values.GetData()), values.Num() * sizeof(T));
+    }
+
+    bool ParseEntry(FArchive& archive, uint64 contentHash, uint32 settingsVersion, TArray<MeshBuffers>& outLods) {
+        CacheReader reader{ archive, archive.TotalSize() };
+        CacheHeader header;
+        if (!reader.Read(&header, sizeof(header))) return false;
+        if (header.Magic != CacheMagic || header.FormatVersion != CacheFormatVersion) return false;
+        if (header.SettingsVersion != settingsVersion || header.ContentHash != contentHash) return false;
+        if (header.NumLods <= 0 || header.NumLods > MAX_STATIC_MESH_LODS) return false;
+        if (archive.Tell() + header.NumLods * MinLodBytes > reader.Size) return false;
+
+        outLods.SetNum(header.NumLods);
+        for (MeshBuffers& lod : outLods) {
+            CacheLodHeader lodHeader;
+            if (!reader.Read(&lodHeader, sizeof(lodHeader))) return false;
+            if (lodHeader.NumVertices <= 0 || lodHeader.NumIndices <= 0 || lodHeader.NumIndices % 3 != 0) return false;
+            if (!reader.ReadArray(lod.Positions, lodHeader.NumVertices)) return false;
+            if (!reader.ReadArray(lod.Normals, lodHeader.NumVertices)) return false;
+            if (!reader.ReadArray(lod.UVs, lodHeader.NumVertices)) return false;
+            if (!reader.ReadArray(lod.Indices, lodHeader.NumIndices)) return false;
+            for (uint32 index : lod.Indices)
+                if (index >= uint32(lodHeader.NumVertices)) return false;
+        }
+        return archive.Tell() == reader.Size;
+    }
+
+    FAutoConsoleCommand ClearMeshCacheCommand(
+        TEXT("IFC.MeshCache.Clear"),
+        TEXT("Deletes the on-disk mesh cache in the default directory."),
+        FConsoleCommandDelegate::CreateLambda([]() { MeshDiskCache::Clear(MeshDiskCache::GetDefaultDirectory()); }));
+}
+
+FString MeshDiskCache::GetDefaultDirectory() {
+    return FPaths::ProjectSavedDir() / TEXT("IFC") / TEXT("MeshCache");
+}
+
+uint32 MeshDiskCache::ComputeSettingsVersion(const MeshBuildSettings& settings) {
+    const MeshOptimizationSettings& o = settings.Optimization;
+    const MeshLodSettings& l = settings.Lods;
+    uint32 h = CacheFormatVersion;
+    h = HashCombine(h, GetTypeHash(o.Weld));
+    h = HashCombine(h, GetTypeHash(o.OptimizeVertexCache));
+    h = HashCombine(h, GetTypeHash(o.OptimizeOverdraw));
+    h = HashCombine(h, GetTypeHash(o.OptimizeVertexFetch));
+    h = HashCombine(h, GetTypeHash(o.VertexCacheSize));
+    h = HashCombine(h, GetTypeHash(o.OverdrawThreshold));
+    h = HashCombine(h, GetTypeHash(l.Enabled));
+    if (l.Enabled) {
+        h = HashCombine(h, GetTypeHash(l.MinTriangles));
+        h = HashCombine(h, GetTypeHash(l.MaxLods));
+        h = HashCombine(h, GetTypeHash(l.TriangleRatio));
+        h = HashCombine(h, GetTypeHash(l.MaxError));
+    }
+    return h;
+}
+
+void MeshDiskCache::Clear(const FString& directory) {
+    if (directory.IsEmpty()) return;
+    IFileManager::Get().DeleteDirectory(*directory, false, true);
+    UE_LOG(LogTemp, Log, TEXT(">>> Cleared mesh cache %s"), *directory);
+}
+
+void MeshDiskCache::Configure(const MeshDiskCacheSettings& settings, uint32 settingsVersion) {
+    const FString directory = settings.Directory.IsEmpty() ? GetDefaultDirectory() : settings.Directory;
+    if (directory != Directory) TotalBytes = -1;
+    Settings = settings;
+    Directory = directory;
+    SettingsVersion = settingsVersion;
+}
+
+FString MeshDiskCache::GetPath(uint64 contentHash) const {
+    return Directory / FString::Printf(TEXT("%016llx-%08x%s"), contentHash, SettingsVersion, CacheExtension);
+}
+
+bool MeshDiskCache::Load(uint64 contentHash, TArray<MeshBuffers>& outLods) const {
+    if (!Settings.Enabled || contentHash == 0) return false;
+    const FString path = GetPath(contentHash);
+
+    TUniquePtr<FArchive> archive(IFileManager::Get().CreateFileReader(*path, FILEREAD_Silent));
+    if (!archive) return false;
+    const bool parsed = ParseEntry(*archive, contentHash, SettingsVersion, outLods);
+    archive.Reset();
+
+    if (!parsed) {
+        outLods.Reset();
+        IFileManager::Get().Delete(*path, false, true, true);
+        return false;
+    }
+    // Modification time doubles as last access for trimming
+    IFileManager::Get().SetTimeStamp(*path, FDateTime::UtcNow());
+    return true;
+}
+
+bool MeshDiskCache::Contains(uint64 contentHash) const {
+    return Settings.Enabled && contentHash != 0 && FPaths::FileExists(GetPath(contentHash));
+}
+
+bool MeshDiskCache::Store(uint64 contentHash, TArrayView<const MeshBuffers> lods) {
+    if (!Settings.Enabled || contentHash == 0 || lods.Num() == 0) return false;
+
+    int64 size = sizeof(CacheHeader);
+    for (const MeshBuffers& lod : lods)
+        size += sizeof(CacheLodHeader) + int64(lod.NumVertices()) * (2 * sizeof(FVector3f) + sizeof(FVector2f)) + int64(lod.Indices.Num()) * sizeof(uint32);
+    if (size > Settings.MaxEntryBytes) return false;
+
+    TArray<uint8> data;
+    data.Reserve(size);
+    const CacheHeader header{ CacheMagic, CacheFormatVersion, SettingsVersion, lods.Num(), contentHash };
+    data.Append(reinterpret_cast<const uint8*>(&header), sizeof(header));
+    for (const MeshBuffers& lod : lods) {
+        if (lod.Normals.Num() != lod.NumVertices() || lod.UVs.Num() != lod.NumVertices()) return false;
+        const CacheLodHeader lodHeader{ lod.NumVertices(), lod.Indices.Num() };
+        data.Append(reinterpret_cast<const uint8*>(&lodHeader), sizeof(lodHeader));
+        WriteArray(data, lod.Positions);
+        WriteArray(data, lod.Normals);
+        WriteArray(data, lod.UVs);
+        WriteArray(data, lod.Indices);
+    }
+
+    // Write then rename so a crash never leaves a truncated entry behind
+    const FString path = GetPath(contentHash);
+    const FString tempPath = path + TEXT(".tmp");
+    if (!FFileHelper::SaveArrayToFile(data, *tempPath)) return false;
+    if (!IFileManager::Get().Move(*path, *tempPath, true, true)) {
+        IFileManager::Get().Delete(*tempPath, false, true, true);
+        return false;
+    }
+
+    if (TotalBytes < 0) ScanDirectory();
+    else TotalBytes += data.Num();
+    if (TotalBytes > Settings.MaxBytes) Trim(Settings.MaxBytes - Settings.MaxBytes / 10);
+    return true;
+}
+
+void MeshDiskCache::ScanDirectory() {
+    TotalBytes = 0;
+    IFileManager::Get().IterateDirectoryStat(*Directory, [this](const TCHAR* path, const FFileStatData& stat) {
+        if (!stat.bIsDirectory && FStringView(path).EndsWith(CacheExtension)) TotalBytes += stat.FileSize;
+        return true;
+    });
+}
+
+void MeshDiskCache::Trim(int64 budget) {
+    struct Entry {
+        FString Path;
+        FDateTime Time;
+        int64 Size;
+    };
+    TArray<Entry> entries;
+    TotalBytes = 0;
+    IFileManager::Get().IterateDirectoryStat(*Directory, [&](const TCHAR* path, const FFileStatData& stat) {
+        if (stat.bIsDirectory || !FStringView(path).EndsWith(CacheExtension)) return true;
+        entries.Add({ path, stat.ModificationTime, stat.FileSize });
+        TotalBytes += stat.FileSize;
+        return true;
+    });
+    if (TotalBytes <= budget) return;
+
+    entries.Sort([](const Entry& a, const Entry& b) { return a.Time < b.Time; });
+    int32 deleted = 0;
+    for (const Entry& entry : entries) {
+        if (TotalBytes <= budget) break;
+        if (!IFileManager::Get().Delete(*entry.Path, false, true, true)) continue;
+        TotalBytes -= entry.Size;
+        ++deleted;
+    }
+    UE_LOG(LogTemp, Log, TEXT(">>> Trimmed %d mesh cache entries, %lld bytes left"), deleted, TotalBytes);
+}
+
+void MeshDiskCache::Clear() {
+    Clear(Directory);
+    TotalBytes = 0;
+}
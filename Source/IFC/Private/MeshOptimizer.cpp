@@ -0,0 +1,396 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MeshOptimizer.h"
+#include "Algo/StableSort.h"
+
+namespace {
+    struct VertexKey {
+        FVector3f Position;
+        FVector3f Normal;
+        FVector2f UV;
+
+        bool operator==(const VertexKey& other) const {
+            return Position == other.Position && Normal == other.Normal && UV == other.UV;
+        }
+
+        friend uint32 GetTypeHash(const VertexKey& key) {
+            return FCrc::MemCrc32(&key, sizeof(VertexKey));
+        }
+    };
+
+    // Adding zero folds -0.0f into 0.0f so equal keys also hash equal
+    FVector3f CanonicalZero(const FVector3f& v) { return FVector3f(v.X + 0.0f, v.Y + 0.0f, v.Z + 0.0f); }
+    FVector2f CanonicalZero(const FVector2f& v) { return FVector2f(v.X + 0.0f, v.Y + 0.0f); }
+
+    uint32 PackNormal(const FVector3f& n) {
+        auto Pack = [](float v) { return uint32(uint8(int8(FMath::RoundToInt(FMath::Clamp(v, -1.0f, 1.0f) * 127.0f)))); };
+        return Pack(n.X) | (Pack(n.Y) << 8) | (Pack(n.Z) << 16);
+    }
+
+    FVector3f UnpackNormal(uint32 packed) {
+        auto Unpack = [](uint32 v) { return float(int8(uint8(v & 0xFF))) / 127.0f; };
+        return FVector3f(Unpack(packed), Unpack(packed >> 8), Unpack(packed >> 16)).GetSafeNormal();
+    }
+
+    constexpr int32 MaxVertexCacheSize = 32;
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+    float VertexScore(int32 cachePosition, int32 remainingTriangles, int32 cacheSize) {
+        if (remainingTriangles == 0) return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) score = 0.75f;
+            else score = FMath::Pow(1.0f - float(cachePosition - 3) / float(cacheSize - 3), 1.5f);
+        }
+        score += 2.0f * FMath::InvSqrt(float(remainingTriangles));
+        return score;
+    }
+
+    int32 CountCacheMisses(const uint32* tri, TArray<uint32>& fifo, int32& head, int32 cacheSize) {
+        int32 misses = 0;
+        for (int32 k = 0; k < 3; ++k) {
+            if (fifo.Contains(tri[k])) continue;
+            fifo[head] = tri[k];
+            head = (head + 1) % cacheSize;
+            ++misses;
+        }
+        return misses;
+    }
+}
+
+MeshBuffers MeshOptimizer::Expand(const TArray<FVector3f>& points, const TArray<int32>& indices) {
+    MeshBuffers out;
+    out.Positions.Reserve(indices.Num());
+    out.Normals.Reserve(indices.Num());
+    out.UVs.Reserve(indices.Num());
+    out.Indices.Reserve(indices.Num());
+
+    auto PlanarUV = [](const FVector3f& n, const FVector3f& p) {
+        const FVector3f an(FMath::Abs(n.X), FMath::Abs(n.Y), FMath::Abs(n.Z));
+        if (an.X >= an.Y && an.X >= an.Z) return FVector2f(p.Y, p.Z);
+        if (an.Y >= an.X && an.Y >= an.Z) return FVector2f(p.X, p.Z);
+        return FVector2f(p.X, p.Y);
+    };
+
+    for (int32 i = 0; i + 2 < indices.Num(); i += 3) {
+        const int32 i0 = indices[i + 0], i1 = indices[i + 1], i2 = indices[i + 2];
+        if (!points.IsValidIndex(i0) || !points.IsValidIndex(i1) || !points.IsValidIndex(i2)) continue;
+
+        const FVector3f corners[3] = { points[i0], points[i1], points[i2] };
+        const FVector3f n = FVector3f::CrossProduct(corners[1] - corners[0], corners[2] - corners[0]);
+        FVector3f faceN = n;
+        if (!faceN.Normalize()) faceN = FVector3f(0, 0, 1);
+
+        for (const FVector3f& p : corners) {
+            out.Indices.Add(out.Positions.Num());
+            out.Positions.Add(p);
+            out.Normals.Add(faceN);
+            out.UVs.Add(PlanarUV(n, p));
+        }
+    }
+    return out;
+}
+
+void MeshOptimizer::Weld(MeshBuffers& buffers) {
+    const int32 numVertices = buffers.NumVertices();
+    TMap<VertexKey, uint32> unique;
+    unique.Reserve(numVertices);
+    TArray<uint32> remap;
+    remap.SetNumUninitialized(numVertices);
+
+    MeshBuffers welded;
+    welded.Positions.Reserve(numVertices);
+    welded.Normals.Reserve(numVertices);
+    welded.UVs.Reserve(numVertices);
+
+    for (int32 v = 0; v < numVertices; ++v) {
+        const VertexKey key{ CanonicalZero(buffers.Positions[v]), CanonicalZero(buffers.Normals[v]), CanonicalZero(buffers.UVs[v]) };
+        if (const uint32* found = unique.Find(key)) {
+            remap[v] = *found;
+            continue;
+        }
+        const uint32 newIndex = welded.Positions.Num();
+        unique.Add(key, newIndex);
+        remap[v] = newIndex;
+        welded.Positions.Add(buffers.Positions[v]);
+        welded.Normals.Add(buffers.Normals[v]);
+        welded.UVs.Add(buffers.UVs[v]);
+    }
+
+    welded.Indices = MoveTemp(buffers.Indices);
+    for (uint32& index : welded.Indices) index = remap[index];
+    buffers = MoveTemp(welded);
+}
+
+void MeshOptimizer::OptimizeVertexCache(MeshBuffers& buffers, int32 cacheSize) {
+    const int32 numVertices = buffers.NumVertices();
+    const int32 numTriangles = buffers.NumTriangles();
+    if (numTriangles < 2) return;
+    cacheSize = FMath::Clamp(cacheSize, 4, MaxVertexCacheSize);
+
+    const TArray<uint32>& indices = buffers.Indices;
+
+    // Vertex -> triangle adjacency in CSR form
+    TArray<int32> remaining; remaining.SetNumZeroed(numVertices);
+    for (uint32 index : indices) ++remaining[index];
+    TArray<int32> offsets; offsets.SetNumUninitialized(numVertices + 1);
+    offsets[0] = 0;
+    for (int32 v = 0; v < numVertices; ++v) offsets[v + 1] = offsets[v] + remaining[v];
+    TArray<int32> adjacency; adjacency.SetNumUninitialized(indices.Num());
+    {
+        TArray<int32> fill = offsets;
+        for (int32 t = 0; t < numTriangles; ++t)
+            for (int32 k = 0; k < 3; ++k) adjacency[fill[indices[t * 3 + k]]++] = t;
+    }
+
+    TArray<int32> cachePosition; cachePosition.Init(-1, numVertices);
+    TArray<float> vertexScore; vertexScore.SetNumUninitialized(numVertices);
+    for (int32 v = 0; v < numVertices; ++v) vertexScore[v] = VertexScore(-1, remaining[v], cacheSize);
+
+    TArray<float> triangleScore; triangleScore.SetNumUninitialized(numTriangles);
+    TBitArray<> emitted(false, numTriangles);
+    for (int32 t = 0; t < numTriangles; ++t)
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+    TArray<uint32> cache, nextCache;
+    cache.Reserve(cacheSize + 3);
+    nextCache.Reserve(cacheSize + 3);
+
+    TArray<uint32> result;
+    result.Reserve(indices.Num());
+
+    int32 cursor = 0;
+    int32 best = INDEX_NONE;
+    while (result.Num() < indices.Num()) {
+        if (best == INDEX_NONE) {
+            // Nothing adjacent to the cache: continue from the next unemitted triangle
+            while (cursor < numTriangles && emitted[cursor]) ++cursor;
+            if (cursor == numTriangles) break;
+            best = cursor;
+        }
+
+        const uint32 tri[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+        result.Append(tri, 3);
+        emitted[best] = true;
+
+        nextCache.Reset();
+        for (uint32 v : tri) {
+            nextCache.AddUnique(v);
+            int32* begin = adjacency.GetData() + offsets[v];
+            int32* end = begin + remaining[v];
+            int32* it = begin;
+            while (it != end && *it != best) ++it;
+            if (it != end) { *it = *(end - 1); --remaining[v]; }
+        }
+        for (uint32 v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2]) nextCache.Add(v);
+
+        for (int32 i = 0; i < nextCache.Num(); ++i) {
+            const uint32 v = nextCache[i];
+            cachePosition[v] = i < cacheSize ? i : -1;
+            const float newScore = VertexScore(cachePosition[v], remaining[v], cacheSize);
+            const float delta = newScore - vertexScore[v];
+            vertexScore[v] = newScore;
+            for (int32 a = offsets[v]; a < offsets[v] + remaining[v]; ++a) triangleScore[adjacency[a]] += delta;
+        }
+
+        best = INDEX_NONE;
+        float bestScore = -1.0f;
+        for (int32 i = 0; i < FMath::Min(nextCache.Num(), cacheSize); ++i) {
+            const uint32 v = nextCache[i];
+            for (int32 a = offsets[v]; a < offsets[v] + remaining[v]; ++a) {
+                const int32 t = adjacency[a];
+                if (triangleScore[t] > bestScore) { bestScore = triangleScore[t]; best = t; }
+            }
+        }
+
+        if (nextCache.Num() > cacheSize) nextCache.RemoveAt(cacheSize, nextCache.Num() - cacheSize);
+        Swap(cache, nextCache);
+    }
+
+    buffers.Indices = MoveTemp(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(MeshBuffers& buffers, int32 cacheSize, float threshold) {
+    const int32 numTriangles = buffers.NumTriangles();
+    if (numTriangles < 2) return;
+    cacheSize = FMath::Clamp(cacheSize, 4, MaxVertexCacheSize);
+
+    const TArray<uint32>& indices = buffers.Indices;
+    const TArray<FVector3f>& positions = buffers.Positions;
+
+    // Cluster boundaries are the points where the cache-optimized order already misses every vertex
+    TArray<int32> clusterStarts;
+    {
+        TArray<uint32> fifo; fifo.Init(MAX_uint32, cacheSize);
+        int32 head = 0;
+        for (int32 t = 0; t < numTriangles; ++t)
+            if (CountCacheMisses(&indices[t * 3], fifo, head, cacheSize) == 3) clusterStarts.Add(t);
+    }
+    if (clusterStarts.Num() < 2) return;
+    clusterStarts.Add(numTriangles);
+
+    struct Cluster { int32 Start; int32 End; FVector3f Centroid; FVector3f Normal; float Sort; };
+    TArray<Cluster> clusters;
+    clusters.Reserve(clusterStarts.Num() - 1);
+    FVector3f meshCentroid = FVector3f::ZeroVector;
+    float meshArea = 0.0f;
+    for (int32 c = 0; c + 1 < clusterStarts.Num(); ++c) {
+        FVector3f centroid = FVector3f::ZeroVector, normal = FVector3f::ZeroVector;
+        float area = 0.0f;
+        for (int32 t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+            const FVector3f& p0 = positions[indices[t * 3]];
+            const FVector3f& p1 = positions[indices[t * 3 + 1]];
+            const FVector3f& p2 = positions[indices[t * 3 + 2]];
+            const FVector3f n = FVector3f::CrossProduct(p1 - p0, p2 - p0);
+            const float a = n.Size();
+            centroid += (p0 + p1 + p2) * (a / 3.0f);
+            normal += n;
+            area += a;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        normal.Normalize();
+        clusters.Add({ clusterStarts[c], clusterStarts[c + 1], area > 0.0f ? centroid / area : positions[indices[clusterStarts[c] * 3]], normal, 0.0f });
+    }
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    // Outward-facing clusters far from the centre go first so they occlude the rest
+    for (Cluster& cluster : clusters) cluster.Sort = FVector3f::DotProduct(cluster.Centroid - meshCentroid, cluster.Normal);
+    Algo::StableSortBy(clusters, [](const Cluster& cluster) { return -cluster.Sort; });
+
+    TArray<uint32> result;
+    result.Reserve(indices.Num());
+    for (const Cluster& cluster : clusters)
+        result.Append(&indices[cluster.Start * 3], (cluster.End - cluster.Start) * 3);
+
+    // Keep the cache order when the reordering costs more vertex transforms than allowed
+    if (ComputeAcmr(result, cacheSize) > ComputeAcmr(indices, cacheSize) * threshold) return;
+    buffers.Indices = MoveTemp(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(MeshBuffers& buffers) {
+    const int32 numVertices = buffers.NumVertices();
+    TArray<uint32> remap;
+    remap.Init(MAX_uint32, numVertices);
+
+    MeshBuffers ordered;
+    ordered.Positions.Reserve(numVertices);
+    ordered.Normals.Reserve(numVertices);
+    ordered.UVs.Reserve(numVertices);
+    ordered.Indices = MoveTemp(buffers.Indices);
+
+    for (uint32& index : ordered.Indices) {
+        if (remap[index] == MAX_uint32) {
+            remap[index] = ordered.Positions.Num();
+            ordered.Positions.Add(buffers.Positions[index]);
+            ordered.Normals.Add(buffers.Normals[index]);
+            ordered.UVs.Add(buffers.UVs[index]);
+        }
+        index = remap[index];
+    }
+    buffers = MoveTemp(ordered);
+}
+
+void MeshOptimizer::Optimize(MeshBuffers& buffers, const MeshOptimizationSettings& settings) {
+    if (settings.Weld) Weld(buffers);
+    if (settings.OptimizeVertexCache) OptimizeVertexCache(buffers, settings.VertexCacheSize);
+    if (settings.OptimizeOverdraw) OptimizeOverdraw(buffers, settings.VertexCacheSize, settings.OverdrawThreshold);
+    if (settings.OptimizeVertexFetch) OptimizeVertexFetch(buffers);
+}
+
+float MeshOptimizer::ComputeAcmr(const TArray<uint32>& indices, int32 cacheSize) {
+    const int32 numTriangles = indices.Num() / 3;
+    if (numTriangles == 0) return 0.0f;
+    TArray<uint32> fifo; fifo.Init(MAX_uint32, cacheSize);
+    int32 head = 0;
+    int32 misses = 0;
+    for (int32 t = 0; t < numTriangles; ++t) misses += CountCacheMisses(&indices[t * 3], fifo, head, cacheSize);
+    return float(misses) / float(numTriangles);
+}
+
+bool MeshOptimizer::FitsHalfPrecisionUVs(const TArray<FVector2f>& uvs, float tolerance) {
+    for (const FVector2f& uv : uvs) {
+        const FVector2f roundTrip = FVector2f(FVector2DHalf(uv));
+        if (!roundTrip.Equals(uv, tolerance)) return false;
+    }
+    return true;
+}
+
+CompactMeshBuffers CompactMeshBuffers::Pack(const MeshBuffers& buffers, int32 positionBits) {
+    CompactMeshBuffers out;
+    out.NumVertices = buffers.NumVertices();
+    out.PositionBits = FMath::Clamp(positionBits, 0, 16);
+
+    if (out.PositionBits > 0 && out.NumVertices > 0) {
+        const FBox3f bounds(buffers.Positions);
+        out.BoundsMin = bounds.Min;
+        out.BoundsSize = bounds.GetSize();
+        const float steps = float((1 << out.PositionBits) - 1);
+        out.QuantizedPositions.SetNumUninitialized(out.NumVertices * 3);
+        for (int32 v = 0; v < out.NumVertices; ++v) {
+            const FVector3f& p = buffers.Positions[v];
+            for (int32 axis = 0; axis < 3; ++axis) {
+                const float size = out.BoundsSize[axis];
+                const float t = size > 0.0f ? (p[axis] - out.BoundsMin[axis]) / size : 0.0f;
+                out.QuantizedPositions[v * 3 + axis] = uint16(FMath::RoundToInt(FMath::Clamp(t, 0.0f, 1.0f) * steps));
+            }
+        }
+    } else {
+        out.Positions = buffers.Positions;
+    }
+
+    out.Normals.Reserve(out.NumVertices);
+    for (const FVector3f& n : buffers.Normals) out.Normals.Add(PackNormal(n));
+
+    if (MeshOptimizer::FitsHalfPrecisionUVs(buffers.UVs)) {
+        out.HalfUVs.Reserve(out.NumVertices);
+        for (const FVector2f& uv : buffers.UVs) out.HalfUVs.Add(FVector2DHalf(uv));
+    } else {
+        out.UVs = buffers.UVs;
+    }
+
+    if (out.NumVertices <= MAX_uint16 + 1) {
+        out.Indices16.Reserve(buffers.Indices.Num());
+        for (uint32 index : buffers.Indices) out.Indices16.Add(uint16(index));
+    } else {
+        out.Indices32 = buffers.Indices;
+    }
+    return out;
+}
+
+MeshBuffers CompactMeshBuffers::Unpack() const {
+    MeshBuffers out;
+    if (PositionBits > 0) {
+        const float steps = float((1 << PositionBits) - 1);
+        out.Positions.SetNumUninitialized(NumVertices);
+        for (int32 v = 0; v < NumVertices; ++v)
+            for (int32 axis = 0; axis < 3; ++axis)
+                out.Positions[v][axis] = BoundsMin[axis] + BoundsSize[axis] * (float(QuantizedPositions[v * 3 + axis]) / steps);
+    } else {
+        out.Positions = Positions;
+    }
+
+    out.Normals.Reserve(NumVertices);
+    for (uint32 n : Normals) out.Normals.Add(UnpackNormal(n));
+
+    if (HalfUVs.Num() > 0) {
+        out.UVs.Reserve(NumVertices);
+        for (const FVector2DHalf& uv : HalfUVs) out.UVs.Add(FVector2f(uv));
+    } else {
+        out.UVs = UVs;
+    }
+
+    if (Indices16.Num() > 0) {
+        out.Indices.Reserve(Indices16.Num());
+        for (uint16 index : Indices16) out.Indices.Add(index);
+    } else {
+        out.Indices = Indices32;
+    }
+    return out;
+}
+
+SIZE_T CompactMeshBuffers::GetAllocatedSize() const {
+    return QuantizedPositions.GetAllocatedSize() + Positions.GetAllocatedSize() + Normals.GetAllocatedSize()
+        + HalfUVs.GetAllocatedSize() + UVs.GetAllocatedSize() + Indices16.GetAllocatedSize() + Indices32.GetAllocatedSize();
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MeshRenderDataBuilder.h"
+#include "StaticMeshResources.h"
+
+namespace {
+    // Tangent frame matching the planar UV projection used by MeshOptimizer::Expand
+    void PlanarTangents(const FVector3f& n, FVector3f& outX, FVector3f& outY) {
+        const FVector3f an(FMath::Abs(n.X), FMath::Abs(n.Y), FMath::Abs(n.Z));
+        if (an.X >= an.Y && an.X >= an.Z) { outX = FVector3f(0, 1, 0); outY = FVector3f(0, 0, 1); }
+        else if (an.Y >= an.X && an.Y >= an.Z) { outX = FVector3f(1, 0, 0); outY = FVector3f(0, 0, 1); }
+        else { outX = FVector3f(1, 0, 0); outY = FVector3f(0, 1, 0); }
+        outX = (outX - n * FVector3f::DotProduct(n, outX)).GetSafeNormal();
+        outY = FVector3f::CrossProduct(n, outX);
+    }
+}
+
+bool MeshRenderDataBuilder::NeedsFullBuild(const MeshBuffers& buffers, const MeshBuildSettings& settings) {
+    if (!settings.FastPath || settings.MikkTSpaceTangents) return true;
+    if (settings.FastPathMaxTriangles > 0 && buffers.NumTriangles() > settings.FastPathMaxTriangles) return true;
+    return buffers.NumVertices() == 0 || buffers.Normals.Num() != buffers.NumVertices() || buffers.UVs.Num() != buffers.NumVertices();
+}
+
+TUniquePtr<FStaticMeshRenderData> MeshRenderDataBuilder::Build(const MeshBuffers& buffers, bool compact, bool needsCpuAccess) {
+    const float screenSize = 1.0f;
+    return Build(MakeArrayView(&buffers, 1), MakeArrayView(&screenSize, 1), compact, needsCpuAccess);
+}
+
+TUniquePtr<FStaticMeshRenderData> MeshRenderDataBuilder::Build(TArrayView<const MeshBuffers> lods, TArrayView<const float> screenSizes, bool compact, bool needsCpuAccess) {
+    const int32 numLods = FMath::Min(lods.Num(), MAX_STATIC_MESH_LODS);
+    if (numLods == 0 || lods[0].NumVertices() == 0 || lods[0].NumTriangles() == 0) return nullptr;
+
+    TUniquePtr<FStaticMeshRenderData> renderData = MakeUnique<FStaticMeshRenderData>();
+    renderData->AllocateLODResources(numLods);
+
+    for (int32 lodIndex = 0; lodIndex < numLods; ++lodIndex) {
+        const MeshBuffers& buffers = lods[lodIndex];
+        const int32 numVertices = buffers.NumVertices();
+        FStaticMeshLODResources& lod = renderData->LODResources[lodIndex];
+
+        lod.VertexBuffers.PositionVertexBuffer.Init(buffers.Positions, needsCpuAccess);
+
+        FStaticMeshVertexBuffer& vertexBuffer = lod.VertexBuffers.StaticMeshVertexBuffer;
+        vertexBuffer.SetUseFullPrecisionUVs(!compact || !MeshOptimizer::FitsHalfPrecisionUVs(buffers.UVs));
+        vertexBuffer.Init(numVertices, 1, needsCpuAccess);
+        for (int32 i = 0; i < numVertices; ++i) {
+            FVector3f tangentX, tangentY;
+            PlanarTangents(buffers.Normals[i], tangentX, tangentY);
+            vertexBuffer.SetVertexTangents(i, tangentX, tangentY, buffers.Normals[i]);
+            vertexBuffer.SetVertexUV(i, 0, buffers.UVs[i]);
+        }
+
+        // Without a color stream the vertex factory falls back to white
+        if (!compact) lod.VertexBuffers.ColorVertexBuffer.InitFromSingleColor(FColor::White, numVertices);
+
+        lod.IndexBuffer.SetIndices(buffers.Indices, numVertices > MAX_uint16 ? EIndexBufferStride::Force32Bit : EIndexBufferStride::Force16Bit);
+
+        FStaticMeshSection& section = lod.Sections.AddDefaulted_GetRef();
+        section.MaterialIndex = 0;
+        section.FirstIndex = 0;
+        section.NumTriangles = buffers.NumTriangles();
+        section.MinVertexIndex = 0;
+        section.MaxVertexIndex = numVertices - 1;
+        section.bEnableCollision = false;
+        section.bCastShadow = true;
+
+        renderData->ScreenSize[lodIndex].Default = screenSizes.IsValidIndex(lodIndex) ? screenSizes[lodIndex] : 0.0f;
+    }
+
+    renderData->Bounds = FBoxSphereBounds(FBox(FBox3f(lods[0].Positions)));
+    return renderData;
+}
+
+bool MeshRenderDataBuilder::Read(const FStaticMeshLODResources& lod, MeshBuffers& outBuffers) {
+    const FPositionVertexBuffer& positions = lod.VertexBuffers.PositionVertexBuffer;
+    const FStaticMeshVertexBuffer& vertexBuffer = lod.VertexBuffers.StaticMeshVertexBuffer;
+    const int32 numVertices = positions.GetNumVertices();
+    if (numVertices == 0 || !positions.GetVertexData() || !vertexBuffer.GetTangentData() || lod.IndexBuffer.GetNumIndices() == 0) return false;
+
+    outBuffers.Positions.SetNumUninitialized(numVertices);
+    outBuffers.Normals.SetNumUninitialized(numVertices);
+    outBuffers.UVs.SetNumUninitialized(numVertices);
+    const bool hasUVs = vertexBuffer.GetNumTexCoords() > 0 && vertexBuffer.GetTexCoordData();
+    for (int32 i = 0; i < numVertices; ++i) {
+        outBuffers.Positions[i] = positions.VertexPosition(i);
+        outBuffers.Normals[i] = FVector3f(vertexBuffer.VertexTangentZ(i));
+        outBuffers.UVs[i] = hasUVs ? vertexBuffer.GetVertexUV(i, 0) : FVector2f::ZeroVector;
+    }
+    lod.IndexBuffer.GetCopy(outBuffers.Indices);
+    return true;
+}
@@ -0,0 +1,195 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "MeshSimplifier.h"
+#include "Algo/Sort.h"
+
+namespace {
+    struct Quadric {
+        double A2 = 0, AB = 0, AC = 0, AD = 0, B2 = 0, BC = 0, BD = 0, C2 = 0, CD = 0, D2 = 0;
+
+        void AddPlane(const FVector3d& n, double d) {
+            A2 += n.X * n.X; AB += n.X * n.Y; AC += n.X * n.Z; AD += n.X * d;
+            B2 += n.Y * n.Y; BC += n.Y * n.Z; BD += n.Y * d;
+            C2 += n.Z * n.Z; CD += n.Z * d;
+            D2 += d * d;
+        }
+
+        Quadric& operator+=(const Quadric& q) {
+            A2 += q.A2; AB += q.AB; AC += q.AC; AD += q.AD;
+            B2 += q.B2; BC += q.BC; BD += q.BD;
+            C2 += q.C2; CD += q.CD;
+            D2 += q.D2;
+            return *this;
+        }
+
+        // Sum of squared distances from p to the accumulated planes
+        double Error(const FVector3d& p) const {
+            return A2 * p.X * p.X + 2 * AB * p.X * p.Y + 2 * AC * p.X * p.Z + 2 * AD * p.X
+                + B2 * p.Y * p.Y + 2 * BC * p.Y * p.Z + 2 * BD * p.Y
+                + C2 * p.Z * p.Z + 2 * CD * p.Z
+                + D2;
+        }
+    };
+
+    struct Collapse {
+        int32 From;
+        int32 To;
+        double Cost;
+    };
+
+    uint64 EdgeKey(int32 a, int32 b) {
+        return a < b ? (uint64(uint32(a)) << 32) | uint32(b) : (uint64(uint32(b)) << 32) | uint32(a);
+    }
+
+    FVector3d TriangleNormal(const FVector3d& p0, const FVector3d& p1, const FVector3d& p2) {
+        return FVector3d::CrossProduct(p1 - p0, p2 - p0);
+    }
+}
+
+void MeshSimplifier::Simplify(const TArray<FVector3f>& points, const TArray<int32>& indices,
+    int32 targetTriangles, float maxError,
+    TArray<FVector3f>& outPoints, TArray<int32>& outIndices) {
+    outPoints.Reset();
+    outIndices.Reset();
+
+    // Weld by position so flat-shaded exports still share topology
+    TMap<FVector3f, int32> unique;
+    unique.Reserve(points.Num());
+    TArray<FVector3d> positions;
+    positions.Reserve(points.Num());
+    TArray<int32> remap;
+    remap.SetNumUninitialized(points.Num());
+    for (int32 i = 0; i < points.Num(); ++i) {
+        if (const int32* found = unique.Find(points[i])) { remap[i] = *found; continue; }
+        remap[i] = positions.Add(FVector3d(points[i]));
+        unique.Add(points[i], remap[i]);
+    }
+
+    TArray<int32> triangles;
+    triangles.Reserve(indices.Num());
+    for (int32 i = 0; i + 2 < indices.Num(); i += 3) {
+        if (!points.IsValidIndex(indices[i]) || !points.IsValidIndex(indices[i + 1]) || !points.IsValidIndex(indices[i + 2])) continue;
+        const int32 a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+        if (a == b || b == c || a == c) continue;
+        triangles.Add(a); triangles.Add(b); triangles.Add(c);
+    }
+
+    const int32 numVertices = positions.Num();
+    TArray<Quadric> quadrics;
+    quadrics.SetNum(numVertices);
+    TMap<uint64, int32> edgeUse;
+    edgeUse.Reserve(triangles.Num());
+    for (int32 t = 0; t < triangles.Num(); t += 3) {
+        const int32 v[3] = { triangles[t], triangles[t + 1], triangles[t + 2] };
+        FVector3d n = TriangleNormal(positions[v[0]], positions[v[1]], positions[v[2]]);
+        if (n.Normalize()) {
+            const double d = -FVector3d::DotProduct(n, positions[v[0]]);
+            for (int32 k = 0; k < 3; ++k) quadrics[v[k]].AddPlane(n, d);
+        }
+        for (int32 k = 0; k < 3; ++k) ++edgeUse.FindOrAdd(EdgeKey(v[k], v[(k + 1) % 3]));
+    }
+
+    TBitArray<> locked(false, numVertices);
+    for (const TPair<uint64, int32>& edge : edgeUse) {
+        if (edge.Value == 2) continue;
+        locked[int32(edge.Key >> 32)] = true;
+        locked[int32(uint32(edge.Key))] = true;
+    }
+
+    const double maxCost = double(maxError) * double(maxError);
+    int32 triangleCount = triangles.Num() / 3;
+    TArray<Collapse> collapses;
+    TArray<int32> adjacencyOffsets, adjacency;
+    TBitArray<> touched;
+    TArray<int32> collapseTo;
+
+    while (triangleCount > targetTriangles) {
+        // Vertex -> triangle adjacency for the current topology
+        adjacencyOffsets.Init(0, numVertices + 1);
+        for (int32 index : triangles) ++adjacencyOffsets[index + 1];
+        for (int32 v = 0; v < numVertices; ++v) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.SetNumUninitialized(triangles.Num());
+        {
+            TArray<int32> fill(adjacencyOffsets.GetData(), numVertices);
+            for (int32 i = 0; i < triangles.Num(); ++i) adjacency[fill[triangles[i]]++] = i / 3;
+        }
+
+        collapses.Reset();
+        TSet<uint64> seen;
+        seen.Reserve(triangles.Num());
+        for (int32 t = 0; t < triangles.Num(); t += 3)
+            for (int32 k = 0; k < 3; ++k) {
+                const int32 a = triangles[t + k], b = triangles[t + (k + 1) % 3];
+                bool alreadySeen = false;
+                seen.Add(EdgeKey(a, b), &alreadySeen);
+                if (alreadySeen) continue;
+
+                if (locked[a] && locked[b]) continue;
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                const double costAB = locked[a] ? TNumericLimits<double>::Max() : q.Error(positions[b]);
+                const double costBA = locked[b] ? TNumericLimits<double>::Max() : q.Error(positions[a]);
+                const double cost = FMath::Min(costAB, costBA);
+                if (cost > maxCost) continue;
+                collapses.Add(costAB <= costBA ? Collapse{ a, b, cost } : Collapse{ b, a, cost });
+            }
+        if (collapses.Num() == 0) break;
+        Algo::SortBy(collapses, &Collapse::Cost);
+
+        touched.Init(false, numVertices);
+        collapseTo.SetNumUninitialized(numVertices);
+        for (int32 v = 0; v < numVertices; ++v) collapseTo[v] = v;
+
+        int32 removed = 0;
+        for (const Collapse& collapse : collapses) {
+            if (triangleCount - removed <= targetTriangles) break;
+            if (touched[collapse.From] || touched[collapse.To]) continue;
+
+            // Reject collapses that flip any surviving triangle around the removed vertex
+            bool flips = false;
+            int32 degenerate = 0;
+            const FVector3d& target = positions[collapse.To];
+            for (int32 a = adjacencyOffsets[collapse.From]; a < adjacencyOffsets[collapse.From + 1] && !flips; ++a) {
+                const int32 t = adjacency[a] * 3;
+                const int32 v[3] = { triangles[t], triangles[t + 1], triangles[t + 2] };
+                if (v[0] == collapse.To || v[1] == collapse.To || v[2] == collapse.To) { ++degenerate; continue; }
+                FVector3d p[3] = { positions[v[0]], positions[v[1]], positions[v[2]] };
+                const FVector3d before = TriangleNormal(p[0], p[1], p[2]);
+                for (int32 k = 0; k < 3; ++k) if (v[k] == collapse.From) p[k] = target;
+                const FVector3d after = TriangleNormal(p[0], p[1], p[2]);
+                flips = FVector3d::DotProduct(before, after) <= 0.0;
+            }
+            if (flips) continue;
+
+            collapseTo[collapse.From] = collapse.To;
+            quadrics[collapse.To] += quadrics[collapse.From];
+            removed += degenerate;
+            touched[collapse.To] = true;
+            for (int32 a = adjacencyOffsets[collapse.From]; a < adjacencyOffsets[collapse.From + 1]; ++a) {
+                const int32 t = adjacency[a] * 3;
+                for (int32 k = 0; k < 3; ++k) touched[triangles[t + k]] = true;
+            }
+        }
+        if (removed == 0) break;
+
+        int32 write = 0;
+        for (int32 t = 0; t < triangles.Num(); t += 3) {
+            const int32 a = collapseTo[triangles[t]], b = collapseTo[triangles[t + 1]], c = collapseTo[triangles[t + 2]];
+            if (a == b || b == c || a == c) continue;
+            triangles[write++] = a; triangles[write++] = b; triangles[write++] = c;
+        }
+        triangles.SetNum(write);
+        triangleCount = write / 3;
+    }
+
+    TArray<int32> compact;
+    compact.Init(INDEX_NONE, numVertices);
+    outIndices.Reserve(triangles.Num());
+    for (int32 index : triangles) {
+        if (compact[index] == INDEX_NONE) {
+            compact[index] = outPoints.Num();
+            outPoints.Add(FVector3f(positions[index]));
+        }
+        outIndices.Add(compact[index]);
+    }
+}
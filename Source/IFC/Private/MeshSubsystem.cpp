@@ -6,8 +6,15 @@
 #include "MeshDescription.h"
 #include "StaticMeshAttributes.h"
 #include "StaticMeshOperations.h"
+#include "MeshOptimizer.h"
+#include "MeshRenderDataBuilder.h"
+#include "MeshSimplifier.h"
+#include "Async/ParallelFor.h"
+#include "StaticMeshResources.h"
+#include "SharedResourceCache.h"
+#include "MemoryTags.h"
 
-static uint64 ComputeContentHash(const TArray<FVector3f>& points, const TArray<int32>& indices) {
+uint64 UMeshSubsystem::ComputeContentHash(const TArray<FVector3f>& points, const TArray<int32>& indices) {
     TArray<uint8> buffer;
     buffer.Reserve(points.Num() * sizeof(FVector3f) + indices.Num() * sizeof(int32));
     if (points.Num() > 0) buffer.Append(reinterpret_cast<const uint8*>(points.GetData()), points.Num() * sizeof(FVector3f));
@@ -15,15 +22,232 @@ static uint64 ComputeContentHash(const TArray<FVector3f>& points, const TArray<i
     return FXxHash64::HashBuffer(buffer.GetData(), buffer.Num()).Hash;
 }
 
+static FBox ComputeBounds(const MeshBuffers& buffers) {
+    FBox bounds(ForceInit);
+    for (const FVector3f& position : buffers.Positions) bounds += FVector(position);
+    return bounds;
+}
+
 int32 UMeshSubsystem::CreateMesh(UWorld* world, const TArray<FVector3f>& points, const TArray<int32>& indices) {
+    LLM_SCOPE_BYTAG(IFC_Meshes);
     if (!world) return INDEX_NONE;
     if (points.Num() == 0) return INDEX_NONE;
     if (indices.Num() == 0 || (indices.Num() % 3) != 0) return INDEX_NONE;
 
-    UStaticMesh* mesh = NewObject<UStaticMesh>(this, NAME_None, RF_Transient);
+    const uint64 h = ComputeContentHash(points, indices);
+    int32 existingId = INDEX_NONE;
+    if (TryFindByHash(h, existingId)) {
+        Retain(existingId);
+        return existingId;
+    }
+    if (TryRegisterShared(h, NeedsCpuAccess(), INDEX_NONE, existingId)) return existingId;
+
+    TArray<MeshBuffers> lods;
+    if (DiskCache.Load(h, lods)) {
+        ++BuildStats.DiskCacheHits;
+        BuildStats.Triangles += lods[0].NumTriangles();
+        if (Settings.Streaming.Enabled) return RegisterStreamedOut(h, ComputeBounds(lods[0]));
+        return BuildAndRegister(lods, MakeScreenSizes(lods.Num()), h);
+    }
+
+    MeshBuffers buffers = MeshOptimizer::Expand(points, indices);
+    if (buffers.NumTriangles() == 0) return INDEX_NONE;
+    const int32 verticesBefore = buffers.NumVertices();
+    MeshOptimizer::Optimize(buffers, Settings.Optimization);
+
+    ++BuildStats.Meshes;
+    BuildStats.VerticesBefore += verticesBefore;
+    BuildStats.VerticesAfter += buffers.NumVertices();
+    BuildStats.Triangles += buffers.NumTriangles();
+
+    lods.Add(MoveTemp(buffers));
+    GenerateLods(h, points, indices, lods);
+
+    const bool stored = DiskCache.Store(h, lods);
+    if (stored) ++BuildStats.DiskCacheWrites;
+    // Streamed meshes are built when the first cell using them loads; too large for the cache, they are built now
+    if (stored && Settings.Streaming.Enabled) return RegisterStreamedOut(h, ComputeBounds(lods[0]));
+    return BuildAndRegister(lods, MakeScreenSizes(lods.Num()), h);
+}
+
+int32 UMeshSubsystem::RegisterStreamedOut(uint64 contentHash, const FBox& bounds) {
+    const int32 newId = EntryData.Reserve();
+    MeshEntryData& newEntry = EntryData.Commit(newId, MeshEntryData());
+    MeshSlot(newId) = nullptr;
+    newEntry.RefCount = 1;
+    newEntry.ContentHash = contentHash;
+    newEntry.CpuAccess = NeedsCpuAccess();
+    newEntry.LastAccess = FPlatformTime::Seconds();
+    newEntry.Bounds = bounds;
+    newEntry.Streamable = true;
+    newEntry.SettingsVersion = BuildSettingsVersion;
+    HashToId.Add(contentHash, newId);
+    return newId;
+}
+
+TArray<float> UMeshSubsystem::MakeScreenSizes(int32 numLods) const {
+    TArray<float> screenSizes;
+    screenSizes.Add(1.0f);
+    for (int32 i = 1; i < numLods; ++i)
+        screenSizes.Add(Settings.Lods.FirstScreenSize * FMath::Pow(Settings.Lods.ScreenSizeRatio, float(i - 1)));
+    return screenSizes;
+}
+
+UStaticMesh* UMeshSubsystem::BuildMesh(TArrayView<const MeshBuffers> lods, TArrayView<const float> screenSizes, bool cpuAccess) {
+    if (!MeshRenderDataBuilder::NeedsFullBuild(lods[0], Settings)) {
+        if (UStaticMesh* mesh = CreateStaticMesh(MeshRenderDataBuilder::Build(lods, screenSizes, Settings.Storage.Compact, cpuAccess))) {
+            ++BuildStats.FastPathMeshes;
+            return mesh;
+        }
+    }
+    return BuildStaticMesh(lods, screenSizes, cpuAccess);
+}
+
+int32 UMeshSubsystem::BuildAndRegister(TArrayView<const MeshBuffers> lods, TArrayView<const float> screenSizes, uint64 contentHash) {
+    const bool cpuAccess = NeedsCpuAccess();
+    UStaticMesh* mesh = BuildMesh(lods, screenSizes, cpuAccess);
     if (!mesh) return INDEX_NONE;
+    return RegisterMesh(mesh, contentHash, cpuAccess);
+}
+
+bool UMeshSubsystem::NeedsCpuAccess() const {
+    return !Settings.Storage.Compact || !Settings.Storage.ReleaseCpuData || CpuConsumers.Num() > 0;
+}
+
+void UMeshSubsystem::AddCpuConsumer(FName consumer) {
+    CpuConsumers.Add(consumer);
+}
+
+void UMeshSubsystem::RemoveCpuConsumer(FName consumer) {
+    CpuConsumers.Remove(consumer);
+}
+
+bool UMeshSubsystem::HasCpuAccess(int32 id) const {
+    const MeshEntryData* entry = EntryData.Find(id);
+    return entry && entry->CpuAccess;
+}
+
+void UMeshSubsystem::GenerateLods(uint64 contentHash, const TArray<FVector3f>& points, const TArray<int32>& indices, TArray<MeshBuffers>& lods) {
+    const MeshLodSettings& lodSettings = Settings.Lods;
+    const int32 baseTriangles = lods[0].NumTriangles();
+    if (!lodSettings.Enabled || baseTriangles < lodSettings.MinTriangles) return;
+
+    const LodCacheKey key(contentHash, LodSettingsVersion);
+    if (const TArray<CompactMeshBuffers>* cached = LodCache.Find(key)) {
+        for (const CompactMeshBuffers& lod : *cached) lods.Add(lod.Unpack());
+        ++BuildStats.LodCacheHits;
+        return;
+    }
+
+    const int32 numLods = FMath::Clamp(lodSettings.MaxLods, 0, MAX_STATIC_MESH_LODS - 1);
+    const MeshOptimizationSettings optimization = Settings.Optimization;
+    TArray<MeshBuffers> generated;
+    generated.SetNum(numLods);
+    ParallelFor(numLods, [&](int32 i) {
+        const int32 targetTriangles = FMath::Max(4, FMath::FloorToInt(baseTriangles * FMath::Pow(lodSettings.TriangleRatio, float(i + 1))));
+        TArray<FVector3f> simplifiedPoints;
+        TArray<int32> simplifiedIndices;
+        MeshSimplifier::Simplify(points, indices, targetTriangles, lodSettings.MaxError * (i + 1), simplifiedPoints, simplifiedIndices);
+        generated[i] = MeshOptimizer::Expand(simplifiedPoints, simplifiedIndices);
+        MeshOptimizer::Optimize(generated[i], optimization);
+    });
+
+    // Stop at the first LOD the error bound kept from reducing meaningfully
+    TArray<CompactMeshBuffers>& cached = LodCache.Add(key);
+    const int32 positionBits = Settings.Storage.Compact ? Settings.Storage.PositionBits : 0;
+    int32 previousTriangles = baseTriangles;
+    for (MeshBuffers& lod : generated) {
+        if (lod.NumTriangles() == 0 || lod.NumTriangles() > previousTriangles * 0.9f) break;
+        previousTriangles = lod.NumTriangles();
+        cached.Add(CompactMeshBuffers::Pack(lod, positionBits));
+        lods.Add(MoveTemp(lod));
+    }
+
+    if (cached.Num() > 0) ++BuildStats.LodMeshes;
+    for (const CompactMeshBuffers& lod : cached) LodCacheBytes += lod.GetAllocatedSize();
+    LodCacheOrder.Add(key);
+    TrimLodCache();
+}
+
+void UMeshSubsystem::TrimLodCache() {
+    int32 dropped = 0;
+    while (dropped < LodCacheOrder.Num() && LodCacheBytes > SIZE_T(FMath::Max<int64>(Settings.Lods.CacheBytes, 0))) {
+        TArray<CompactMeshBuffers> lods;
+        if (LodCache.RemoveAndCopyValue(LodCacheOrder[dropped++], lods))
+            for (const CompactMeshBuffers& lod : lods) LodCacheBytes -= FMath::Min(LodCacheBytes, lod.GetAllocatedSize());
+    }
+    LodCacheOrder.RemoveAt(0, dropped);
+}
+
+void UMeshSubsystem::ClearLodCache() {
+    LodCache.Empty();
+    LodCacheOrder.Empty();
+    LodCacheBytes = 0;
+}
+
+int32 UMeshSubsystem::CreateMesh(const MeshBuffers& buffers, uint64 contentHash, bool exactLayout) {
+    LLM_SCOPE_BYTAG(IFC_Meshes);
+    int32 existingId = INDEX_NONE;
+    if (TryFindByHash(contentHash, existingId)) {
+        Retain(existingId);
+        return existingId;
+    }
+    if (TryRegisterShared(contentHash, NeedsCpuAccess(), INDEX_NONE, existingId)) return existingId;
+    if (buffers.NumTriangles() == 0) return INDEX_NONE;
+
+    // The full build welds and drops degenerate triangles, the direct fill writes the buffers as they are
+    if (exactLayout) {
+        const bool cpuAccess = NeedsCpuAccess();
+        UStaticMesh* mesh = CreateStaticMesh(MeshRenderDataBuilder::Build(buffers, Settings.Storage.Compact, cpuAccess));
+        return mesh ? RegisterMesh(mesh, contentHash, cpuAccess) : INDEX_NONE;
+    }
+    const float screenSize = 1.0f;
+    return BuildAndRegister(MakeArrayView(&buffers, 1), MakeArrayView(&screenSize, 1), contentHash);
+}
+
+bool UMeshSubsystem::ReadBuffers(int32 id, MeshBuffers& outBuffers) const {
+    if (!HasCpuAccess(id)) return false;
+    const UStaticMesh* mesh = Get(id);
+    if (!mesh) return false;
+    const FStaticMeshRenderData* renderData = mesh->GetRenderData();
+    if (!renderData || renderData->LODResources.Num() == 0) return false;
+    return MeshRenderDataBuilder::Read(renderData->LODResources[0], outBuffers);
+}
+
+int32 UMeshSubsystem::RegisterRenderData(TUniquePtr<FStaticMeshRenderData> renderData, uint64 contentHash, bool cpuAccess, int32 reservedId) {
+    LLM_SCOPE_BYTAG(IFC_Meshes);
+    int32 existingId = INDEX_NONE;
+    if (TryFindByHash(contentHash, existingId)) {
+        if (reservedId != INDEX_NONE) EntryData.Cancel(reservedId);
+        Retain(existingId);
+        return existingId;
+    }
+    if (TryRegisterShared(contentHash, cpuAccess, reservedId, existingId)) return existingId;
+    UStaticMesh* mesh = CreateStaticMesh(MoveTemp(renderData));
+    if (!mesh) {
+        if (reservedId != INDEX_NONE) EntryData.Cancel(reservedId);
+        return INDEX_NONE;
+    }
+    return RegisterMesh(mesh, contentHash, cpuAccess, reservedId);
+}
+
+UStaticMesh* UMeshSubsystem::CreateStaticMesh(TUniquePtr<FStaticMeshRenderData> renderData) {
+    check(IsInGameThread());
+    if (!renderData) return nullptr;
 
-    FMeshDescription md;
+    UStaticMesh* mesh = NewObject<UStaticMesh>(USharedResourceCache::Get() ? static_cast<UObject*>(USharedResourceCache::Get()) : this, NAME_None, RF_Transient);
+    if (!mesh) return nullptr;
+
+    mesh->GetStaticMaterials().Add(FStaticMaterial(UMaterial::GetDefaultMaterial(MD_Surface), TEXT("Slot0")));
+    mesh->NeverStream = true;
+    mesh->SetRenderData(MoveTemp(renderData));
+
+    mesh->InitResources();
+    mesh->CalculateExtendedBounds();
+    return mesh;
+}
+
+static void FillMeshDescription(FMeshDescription& md, const MeshBuffers& buffers, FName slotName) {
     FStaticMeshAttributes a(md);
     a.Register();
 
@@ -33,106 +257,114 @@ int32 UMeshSubsystem::CreateMesh(UWorld* world, const TArray<FVector3f>& points,
     if (uvs.GetNumChannels() < 1) uvs.SetNumChannels(1);
     TVertexInstanceAttributesRef<FVector3f> normals = a.GetVertexInstanceNormals();
 
-    TArray<FVertexID> vids; vids.Reserve(points.Num());
-    for (const FVector3f& p : points) { FVertexID v = md.CreateVertex(); pos[v] = p; vids.Add(v); }
+    const int32 numVertices = buffers.NumVertices();
+    md.ReserveNewVertices(numVertices);
+    md.ReserveNewVertexInstances(numVertices);
+    md.ReserveNewPolygons(buffers.NumTriangles());
+
+    // Welded vertices still differ by normal or UV, so share the position-only vertex between them
+    TMap<FVector3f, FVertexID> vertexByPosition;
+    vertexByPosition.Reserve(numVertices);
+    TArray<FVertexID> vids; vids.SetNumUninitialized(numVertices);
+    TArray<FVertexInstanceID> viids; viids.SetNumUninitialized(numVertices);
+    for (int32 i = 0; i < numVertices; ++i) {
+        const FVector3f& p = buffers.Positions[i];
+        FVertexID* found = vertexByPosition.Find(p);
+        if (!found) {
+            FVertexID v = md.CreateVertex();
+            pos[v] = p;
+            found = &vertexByPosition.Add(p, v);
+        }
+        vids[i] = *found;
+
+        FVertexInstanceID vi = md.CreateVertexInstance(*found);
+        vtxColors[vi] = FVector4f(1, 1, 1, 1);
+        uvs.Set(vi, 0, buffers.UVs[i]);
+        normals[vi] = buffers.Normals[i];
+        viids[i] = vi;
+    }
 
     FPolygonGroupID pg = md.CreatePolygonGroup();
 
     TPolygonGroupAttributesRef<FName> pgSlotNames = a.GetPolygonGroupMaterialSlotNames();
-    const FName slotName = TEXT("Slot0");
     pgSlotNames[pg] = slotName;
 
-    auto PlanarUV = [](const FVector3f& p0, const FVector3f& p1, const FVector3f& p2, FVector2f& uv0, FVector2f& uv1, FVector2f& uv2) {
-        const FVector3f e0 = p1 - p0;
-        const FVector3f e1 = p2 - p0;
-        const FVector3f n = FVector3f::CrossProduct(e0, e1);
-        const FVector3f an(FMath::Abs(n.X), FMath::Abs(n.Y), FMath::Abs(n.Z));
-        if (an.X >= an.Y && an.X >= an.Z) { uv0 = FVector2f(p0.Y, p0.Z); uv1 = FVector2f(p1.Y, p1.Z); uv2 = FVector2f(p2.Y, p2.Z); }
-        else if (an.Y >= an.X && an.Y >= an.Z) { uv0 = FVector2f(p0.X, p0.Z); uv1 = FVector2f(p1.X, p1.Z); uv2 = FVector2f(p2.X, p2.Z); }
-        else { uv0 = FVector2f(p0.X, p0.Y); uv1 = FVector2f(p1.X, p1.Y); uv2 = FVector2f(p2.X, p2.Y); }
-        };
-
-    for (int32 i = 0; i < indices.Num(); i += 3) {
-        const int32 i0 = indices[i + 0], i1 = indices[i + 1], i2 = indices[i + 2];
-        if (!vids.IsValidIndex(i0) || !vids.IsValidIndex(i1) || !vids.IsValidIndex(i2)) continue;
-
-        const FVector3f p0 = pos[vids[i0]];
-        const FVector3f p1 = pos[vids[i1]];
-        const FVector3f p2 = pos[vids[i2]];
-
-        FVertexInstanceID vi0 = md.CreateVertexInstance(vids[i0]);
-        FVertexInstanceID vi1 = md.CreateVertexInstance(vids[i1]);
-        FVertexInstanceID vi2 = md.CreateVertexInstance(vids[i2]);
-
-        vtxColors[vi0] = FVector4f(1, 1, 1, 1);
-        vtxColors[vi1] = FVector4f(1, 1, 1, 1);
-        vtxColors[vi2] = FVector4f(1, 1, 1, 1);
-
-        FVector2f uv0, uv1, uv2;
-        PlanarUV(p0, p1, p2, uv0, uv1, uv2);
-        uvs.Set(vi0, 0, uv0);
-        uvs.Set(vi1, 0, uv1);
-        uvs.Set(vi2, 0, uv2);
-
-        const FVector3f e0 = p1 - p0;
-        const FVector3f e1 = p2 - p0;
-        FVector3f faceN = FVector3f::CrossProduct(e0, e1);
-        if (!faceN.Normalize()) faceN = FVector3f(0, 0, 1);
-        normals[vi0] = faceN;
-        normals[vi1] = faceN;
-        normals[vi2] = faceN;
-
-        TArray<FVertexInstanceID> tri; tri.Add(vi0); tri.Add(vi1); tri.Add(vi2);
-        md.CreatePolygon(pg, tri);
+    for (int32 i = 0; i < buffers.Indices.Num(); i += 3) {
+        const uint32 i0 = buffers.Indices[i + 0], i1 = buffers.Indices[i + 1], i2 = buffers.Indices[i + 2];
+        if (vids[i0] == vids[i1] || vids[i1] == vids[i2] || vids[i0] == vids[i2]) continue;
+        const FVertexInstanceID tri[3] = { viids[i0], viids[i1], viids[i2] };
+        md.CreatePolygon(pg, MakeArrayView(tri, 3));
     }
 
     FStaticMeshOperations::ComputeTriangleTangentsAndNormals(md);
     FStaticMeshOperations::ComputeTangentsAndNormals(md, EComputeNTBsFlags::Tangents | EComputeNTBsFlags::UseMikkTSpace);
+}
+
+UStaticMesh* UMeshSubsystem::BuildStaticMesh(TArrayView<const MeshBuffers> lods, TArrayView<const float> screenSizes, bool cpuAccess) {
+    UStaticMesh* mesh = NewObject<UStaticMesh>(USharedResourceCache::Get() ? static_cast<UObject*>(USharedResourceCache::Get()) : this, NAME_None, RF_Transient);
+    if (!mesh) return nullptr;
 
-    if (mesh->GetStaticMaterials().Num() == 0) mesh->GetStaticMaterials().Add(FStaticMaterial(UMaterial::GetDefaultMaterial(MD_Surface), TEXT("Slot0")));
+    const FName slotName = TEXT("Slot0");
+    const int32 numLods = FMath::Min(lods.Num(), MAX_STATIC_MESH_LODS);
+    TArray<FMeshDescription> descriptions;
+    descriptions.SetNum(numLods);
+    TArray<const FMeshDescription*> mds;
+    for (int32 i = 0; i < numLods; ++i) {
+        FillMeshDescription(descriptions[i], lods[i], slotName);
+        mds.Add(&descriptions[i]);
+    }
 
     UStaticMesh::FBuildMeshDescriptionsParams params;
-    params.bAllowCpuAccess = true;
+    params.bAllowCpuAccess = cpuAccess;
     params.bBuildSimpleCollision = false;
     params.bCommitMeshDescription = false;
     params.bFastBuild = true;
-    
+
     if (mesh->GetStaticMaterials().Num() == 0) {
         mesh->GetStaticMaterials().Reset();
         mesh->GetStaticMaterials().Add(FStaticMaterial(UMaterial::GetDefaultMaterial(MD_Surface), slotName));
     }
-    
-    TArray<const FMeshDescription*> mds; mds.Add(&md);
-    if (!mesh->BuildFromMeshDescriptions(mds, params)) return INDEX_NONE;
+
+    if (!mesh->BuildFromMeshDescriptions(mds, params)) return nullptr;
+
+    if (FStaticMeshRenderData* renderData = mesh->GetRenderData()) {
+        mesh->bAutoComputeLODScreenSize = false;
+        for (int32 i = 0; i < renderData->LODResources.Num(); ++i)
+            renderData->ScreenSize[i].Default = screenSizes.IsValidIndex(i) ? screenSizes[i] : 0.0f;
+    }
 
     mesh->InitResources();
     mesh->CalculateExtendedBounds();
-
-    uint64 h = ComputeContentHash(points, indices);
-    return RegisterMesh(mesh, h);
+    return mesh;
 }
 
-int32 UMeshSubsystem::RegisterMesh(UStaticMesh* mesh, uint64 contentHash) {
-    if (!mesh) return INDEX_NONE;
+int32 UMeshSubsystem::RegisterMesh(UStaticMesh* mesh, uint64 contentHash, bool cpuAccess, int32 reservedId) {
     int32 existingId = INDEX_NONE;
-    if (contentHash != 0) {
+    if (mesh && contentHash != 0) {
         const int32* foundId = HashToId.Find(contentHash);
         if (foundId) existingId = *foundId;
     }
-    if (existingId != INDEX_NONE) {
-        MeshEntryData* entry = EntryData.Find(existingId);
-        if (!entry) return INDEX_NONE;
-        ++entry->RefCount;
-        entry->LastAccess = FPlatformTime::Seconds();
+    if (!mesh || existingId != INDEX_NONE) {
+        if (reservedId != INDEX_NONE) EntryData.Cancel(reservedId);
+        if (!EntryData.Contains(existingId)) return INDEX_NONE;
+        Retain(existingId);
         return existingId;
     }
-    int32 newId = NextId++;
-    Meshes.Add(newId, mesh);
-    MeshEntryData& newEntry = EntryData.Add(newId);
+    const int32 newId = reservedId != INDEX_NONE ? reservedId : EntryData.Reserve();
+    MeshEntryData& newEntry = EntryData.Commit(newId, MeshEntryData());
+    MeshSlot(newId) = mesh;
     newEntry.RefCount = 1;
     newEntry.ContentHash = contentHash;
+    newEntry.CpuAccess = cpuAccess;
     newEntry.LastAccess = FPlatformTime::Seconds();
+    if (const FStaticMeshRenderData* renderData = mesh->GetRenderData()) newEntry.Bytes = renderData->GetResourceSizeBytes();
+    newEntry.Bounds = mesh->GetBoundingBox();
+    newEntry.SettingsVersion = BuildSettingsVersion;
+    TotalBytes += newEntry.Bytes;
+    if (USharedResourceCache* shared = USharedResourceCache::Get())
+        newEntry.Shared = shared->AddMeshHolder(contentHash, BuildSettingsVersion, mesh, cpuAccess, GetWorld());
     if (contentHash != 0) HashToId.Add(contentHash, newId);
+    TrimCache(CacheBudget);
     return newId;
 }
 
@@ -147,44 +379,183 @@ bool UMeshSubsystem::TryFindByHash(uint64 contentHash, int32& outId) const {
 void UMeshSubsystem::Retain(int32 id) {
     MeshEntryData* entry = EntryData.Find(id);
     if (!entry) return;
-    ++entry->RefCount;
+    if (entry->RefCount++ == 0) Uncache(id);
     entry->LastAccess = FPlatformTime::Seconds();
 }
 
+void UMeshSubsystem::Cache(int32 id) {
+    Cached.PushBack(EntryData, id);
+    CachedBytes += EntryData[id].Bytes;
+}
+
+void UMeshSubsystem::Uncache(int32 id) {
+    MeshEntryData* entry = EntryData.Find(id);
+    if (!entry || !entry->Lru.Linked) return;
+    Cached.Remove(EntryData, id);
+    CachedBytes -= FMath::Min(CachedBytes, entry->Bytes);
+}
+
 void UMeshSubsystem::Release(int32 id, bool destroyNow) {
+    if (ReleaseReference(id, destroyNow)) TrimCache(CacheBudget);
+}
+
+void UMeshSubsystem::ReleaseMany(TArrayView<const int32> ids) {
+    bool trim = false;
+    for (int32 id : ids) trim |= ReleaseReference(id, false);
+    if (trim) TrimCache(CacheBudget);
+}
+
+bool UMeshSubsystem::ReleaseReference(int32 id, bool destroyNow) {
     MeshEntryData* entry = EntryData.Find(id);
-    if (!entry) return;
+    if (!entry || entry->RefCount <= 0) return false;
     --entry->RefCount;
-    if (entry->RefCount > 0) {
-        entry->LastAccess = FPlatformTime::Seconds();
-        return;
+    entry->LastAccess = FPlatformTime::Seconds();
+    if (entry->RefCount > 0) return false;
+    // Meshes without a content hash can never be found again. Streamed out ones hold no memory for the
+    // budget to reclaim and are rebuilt from the disk cache anyway.
+    if (destroyNow || entry->ContentHash == 0 || !Get(id)) {
+        Evict(id, destroyNow);
+        return false;
     }
-    uint64 hash = entry->ContentHash;
-    EntryData.Remove(id);
-    UStaticMesh* mesh = nullptr;
-    if (const TObjectPtr<UStaticMesh>* meshPtr = Meshes.Find(id)) mesh = meshPtr->Get();
-    Meshes.Remove(id);
-    if (hash != 0) HashToId.Remove(hash);
-    if (destroyNow && mesh) mesh->MarkAsGarbage();
+    Cache(id);
+    return true;
+}
+
+int32 UMeshSubsystem::MarkPendingGarbage(double budgetSeconds) {
+    const double deadline = FPlatformTime::Seconds() + budgetSeconds;
+    int32 marked = 0;
+    while (PendingGarbage.Num() > 0 && (marked == 0 || FPlatformTime::Seconds() < deadline)) {
+        if (TObjectPtr<UStaticMesh> mesh = PendingGarbage.Pop()) mesh->MarkAsGarbage();
+        ++marked;
+    }
+    return marked;
+}
+
+bool UMeshSubsystem::TryRegisterShared(uint64 contentHash, bool cpuAccess, int32 reservedId, int32& outId) {
+    USharedResourceCache* shared = USharedResourceCache::Get();
+    UStaticMesh* mesh = shared ? shared->FindMesh(contentHash, BuildSettingsVersion, cpuAccess) : nullptr;
+    if (!mesh) return false;
+    outId = RegisterMesh(mesh, contentHash, cpuAccess, reservedId);
+    if (outId == INDEX_NONE) return false;
+    ++BuildStats.SharedCacheHits;
+    return true;
+}
+
+bool UMeshSubsystem::ReleaseShared(const MeshEntryData& entry) {
+    if (!entry.Shared) return true;
+    USharedResourceCache* shared = USharedResourceCache::Get();
+    return !shared || shared->RemoveMeshHolder(entry.ContentHash, entry.SettingsVersion, GetWorld());
+}
+
+void UMeshSubsystem::Deinitialize() {
+    EntryData.ForEach([this](int32, const MeshEntryData& entry) { ReleaseShared(entry); });
+    ClearLodCache();
+    Super::Deinitialize();
+}
+
+TObjectPtr<UStaticMesh>& UMeshSubsystem::MeshSlot(int32 id) {
+    const int32 index = TSlotMap<MeshEntryData>::IndexOf(id);
+    if (index >= Meshes.Num()) Meshes.SetNum(index + 1);
+    return Meshes[index];
+}
+
+void UMeshSubsystem::Evict(int32 id, bool destroyNow) {
+    Uncache(id);
+    MeshEntryData entry;
+    if (!EntryData.Remove(id, &entry)) return;
+    TotalBytes -= FMath::Min(TotalBytes, entry.Bytes);
+    if (entry.Streamable) StreamableBytes -= FMath::Min(StreamableBytes, entry.Bytes);
+    TObjectPtr<UStaticMesh> mesh = MeshSlot(id);
+    MeshSlot(id) = nullptr;
+    if (entry.ContentHash != 0) HashToId.Remove(entry.ContentHash);
+    // Meshes other worlds still show are left to them
+    if (ReleaseShared(entry) && destroyNow && mesh) PendingGarbage.Add(mesh);
+}
+
+void UMeshSubsystem::SetCacheBudget(SIZE_T bytes) {
+    CacheBudget = bytes;
+    TrimCache(CacheBudget);
+}
+
+void UMeshSubsystem::TrimCache(SIZE_T budget) {
+    while (CachedBytes > budget && Cached.Front() != INDEX_NONE) Evict(Cached.Front(), false);
+}
+
+bool UMeshSubsystem::StreamOut(int32 id) {
+    MeshEntryData* entry = EntryData.Find(id);
+    if (!entry || !entry->Streamable || !Get(id) || !DiskCache.Contains(entry->ContentHash)) return false;
+    // Components may still point at it until they are destroyed, so it is left to the garbage collector
+    MeshSlot(id) = nullptr;
+    ReleaseShared(*entry);
+    entry->Shared = false;
+    TotalBytes -= FMath::Min(TotalBytes, entry->Bytes);
+    StreamableBytes -= FMath::Min(StreamableBytes, entry->Bytes);
+    if (entry->Lru.Linked) CachedBytes -= FMath::Min(CachedBytes, entry->Bytes);
+    entry->Bytes = 0;
+    if (entry->RefCount == 0) Evict(id, false);
+    return true;
+}
+
+UStaticMesh* UMeshSubsystem::GetResident(int32 id) {
+    if (UStaticMesh* mesh = Get(id)) return mesh;
+    LLM_SCOPE_BYTAG(IFC_Meshes);
+    MeshEntryData* entry = EntryData.Find(id);
+    if (!entry) return nullptr;
+    USharedResourceCache* shared = USharedResourceCache::Get();
+    UStaticMesh* mesh = shared ? shared->FindMesh(entry->ContentHash, entry->SettingsVersion, entry->CpuAccess) : nullptr;
+    TArray<MeshBuffers> lods;
+    if (!mesh && DiskCache.Load(entry->ContentHash, lods)) mesh = BuildMesh(lods, MakeScreenSizes(lods.Num()), entry->CpuAccess);
+    if (!mesh) return nullptr;
+    if (shared) entry->Shared = shared->AddMeshHolder(entry->ContentHash, entry->SettingsVersion, mesh, entry->CpuAccess, GetWorld());
+    MeshSlot(id) = mesh;
+    if (const FStaticMeshRenderData* renderData = mesh->GetRenderData()) entry->Bytes = renderData->GetResourceSizeBytes();
+    TotalBytes += entry->Bytes;
+    if (entry->Streamable) StreamableBytes += entry->Bytes;
+    if (entry->Lru.Linked) CachedBytes += entry->Bytes;
+    entry->LastAccess = FPlatformTime::Seconds();
+    return mesh;
 }
 
 UStaticMesh* UMeshSubsystem::Get(int32 id) const {
-    const TObjectPtr<UStaticMesh>* meshPtr = Meshes.Find(id);
-    if (!meshPtr) return nullptr;
-    return meshPtr->Get();
+    if (!EntryData.Contains(id)) return nullptr;
+    const int32 index = TSlotMap<MeshEntryData>::IndexOf(id);
+    return Meshes.IsValidIndex(index) ? Meshes[index].Get() : nullptr;
 }
 
 void UMeshSubsystem::Touch(int32 id) {
     MeshEntryData* entry = EntryData.Find(id);
     if (!entry) return;
     entry->LastAccess = FPlatformTime::Seconds();
+    if (entry->Lru.Linked) Cached.PushBack(EntryData, id);
+}
+
+void UMeshSubsystem::SetBuildSettings(const MeshBuildSettings& settings) {
+    Settings = settings;
+    const uint32 settingsVersion = MeshDiskCache::ComputeSettingsVersion(settings);
+    DiskCache.Configure(settings.DiskCache, settingsVersion);
+    // Cached LODs are packed at the storage precision, so it is part of their key too
+    LodSettingsVersion = HashCombine(settingsVersion, GetTypeHash(settings.Storage.Compact ? settings.Storage.PositionBits : 0));
+    BuildSettingsVersion = HashCombine(LodSettingsVersion, GetTypeHash(settings.Storage.Compact));
+    BuildSettingsVersion = HashCombine(BuildSettingsVersion, GetTypeHash(settings.FastPath));
+    BuildSettingsVersion = HashCombine(BuildSettingsVersion, GetTypeHash(settings.FastPathMaxTriangles));
+    BuildSettingsVersion = HashCombine(BuildSettingsVersion, GetTypeHash(settings.MikkTSpaceTangents));
+    BuildSettingsVersion = HashCombine(BuildSettingsVersion, GetTypeHash(settings.Lods.FirstScreenSize));
+    BuildSettingsVersion = HashCombine(BuildSettingsVersion, GetTypeHash(settings.Lods.ScreenSizeRatio));
+    TrimLodCache();
+}
+
+void UMeshSubsystem::ResetBuildStats() {
+    BuildStats = MeshBuildStats();
 }
 
 MeshStats UMeshSubsystem::GetStats() const {
     MeshStats stats;
     stats.Count = EntryData.Num();
     int32 totalRefCount = 0;
-    for (const auto& entryPair : EntryData) totalRefCount += entryPair.Value.RefCount;
+    EntryData.ForEach([&](int32, const MeshEntryData& entry) { totalRefCount += entry.RefCount; });
     stats.TotalRefCount = totalRefCount;
+    stats.CachedCount = Cached.Num();
+    stats.Bytes = TotalBytes;
+    stats.CachedBytes = CachedBytes;
     return stats;
 }
\ No newline at end of file
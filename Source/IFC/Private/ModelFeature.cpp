@@ -4,11 +4,15 @@
 #include "ModelFeature.h"
 #include "AttributeFeature.h"
 #include "MeshSubsystem.h"
+#include "MeshCanonicalizer.h"
 #include "MaterialSubsystem.h"
 #include "ISMSubsystem.h"
 #include "ECS.h"
 #include "IFC.h"
 #include "LayerFeature.h"
+#include "VisibilityFeature.h"
+#include "StreamingFeature.h"
+#include "Async/ParallelFor.h"
 
 namespace IFC {
 	FTransform ToTransform(const float values[4][4]) {
@@ -30,7 +34,7 @@ namespace IFC {
 		return transform;
 	}
 
-	int32 CreateMesh(flecs::world& world, TArray<FVector3f> points, TArray<int32> indices) {
+	int32 CreateMesh(flecs::world& world, TArray<FVector3f> points, TArray<int32> indices, FTransform& outFrame) {
 		// Correct handedness and units
 		TArray<FVector3f> correctedPoints;
 		correctedPoints.Reserve(points.Num());
@@ -41,7 +45,12 @@ namespace IFC {
 		}
 
 		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
-		return uWorld->GetSubsystem<UMeshSubsystem>()->CreateMesh(uWorld, correctedPoints, indices);
+		UMeshSubsystem* meshSubsystem = uWorld->GetSubsystem<UMeshSubsystem>();
+		outFrame = FTransform::Identity;
+		if (meshSubsystem->GetBuildSettings().Canonicalization.Enabled
+			&& MeshCanonicalizer::Canonicalize(correctedPoints, meshSubsystem->GetBuildSettings().Canonicalization, outFrame))
+			meshSubsystem->CountCanonicalMesh();
+		return meshSubsystem->CreateMesh(uWorld, correctedPoints, indices);
 	}
 
 	int32 CreateMaterial(flecs::world& world, const FVector4f& rgba, float offset) {
@@ -49,31 +58,316 @@ namespace IFC {
 		return uWorld->GetSubsystem<UMaterialSubsystem>()->CreateMaterial(uWorld, rgba, offset);
 	}
 
-	int32 FindMaterial(flecs::world& world, flecs::entity ifcObject) {
+	// Transform parts set by one attribute container; unset parts keep earlier containers' values
+	struct TransformAttributes {
+		TOptional<FVector> Position;
+		TOptional<FRotator> Rotation;
+		TOptional<FVector> Scale;
+	};
+	using TransformAttributesCache = TMap<uint64, TransformAttributes>;
+
+	const TransformAttributes& GetTransformAttributes(flecs::entity attributes, TransformAttributesCache& cache) {
+		if (const TransformAttributes* found = cache.Find(attributes.id()))
+			return *found;
+		TransformAttributes parts;
+		attributes.children([&](flecs::entity attribute) {
+			if (attribute.has<Position>())
+				parts.Position = attribute.try_get<Position>()->Value;
+			if (attribute.has<Rotation>())
+				parts.Rotation = attribute.try_get<Rotation>()->Value;
+			if (attribute.has<Scale>())
+				parts.Scale = attribute.try_get<Scale>()->Value;
+		});
+		return cache.Add(attributes.id(), parts);
+	}
+
+	// Own Position/Rotation/Scale override the attribute values, so playback can move single objects
+	FTransform GetLocalTransform(flecs::entity entity, flecs::entity attributesRel, TransformAttributesCache& cache) {
+		FVector	position = FVector::ZeroVector;
+		FRotator rotation = FRotator::ZeroRotator;
+		FVector scale = FVector::OneVector;
+
+		int32_t i = 0;
+		while (flecs::entity attributes = entity.target(attributesRel, i++)) {
+			const TransformAttributes& parts = GetTransformAttributes(attributes, cache);
+			position = parts.Position.Get(position);
+			rotation = parts.Rotation.Get(rotation);
+			scale = parts.Scale.Get(scale);
+		}
+		if (entity.owns<Position>())
+			position = entity.try_get<Position>()->Value;
+		if (entity.owns<Rotation>())
+			rotation = entity.try_get<Rotation>()->Value;
+		if (entity.owns<Scale>())
+			scale = entity.try_get<Scale>()->Value;
+
+		return FTransform(rotation, position, scale);
+	}
+
+	// Children compose as parentWorld * local. Walks up only to the nearest cached ancestor and caches the way down.
+	FTransform ResolveWorldTransform(flecs::entity entity, flecs::entity attributesRel, TransformAttributesCache& cache) {
+		if (entity.owns<WorldTransform>())
+			return entity.try_get<WorldTransform>()->Value;
+		flecs::entity parent = entity.parent();
+		const FTransform parentWorld = parent.is_valid() ? ResolveWorldTransform(parent, attributesRel, cache) : FTransform::Identity;
+		const FTransform worldTransform = parentWorld * GetLocalTransform(entity, attributesRel, cache);
+		entity.set<WorldTransform>({ worldTransform });
+		return worldTransform;
+	}
+
+	FTransform GetWorldTransform(flecs::world& world, flecs::entity entity) {
+		TransformAttributesCache cache;
+		return ResolveWorldTransform(entity, world.try_get<AttributesRelationship>()->Value, cache);
+	}
+
+	void UpdateWorldTransforms(flecs::world& world, TArrayView<const flecs::entity> roots, TFunctionRef<void(flecs::entity, const FTransform&)> visit) {
 		auto attributesRel = world.try_get<AttributesRelationship>()->Value;
+		TransformAttributesCache cache;
+
+		// Subtrees of other roots are reached from those roots
+		TSet<uint64> rootIds;
+		for (flecs::entity root : roots)
+			rootIds.Add(root.id());
+		TArray<flecs::entity> level;
+		TArray<FTransform> parentWorlds;
+		for (flecs::entity root : roots) {
+			bool covered = false;
+			for (flecs::entity parent = root.parent(); parent.is_valid() && !covered; parent = parent.parent())
+				covered = rootIds.Contains(parent.id());
+			if (covered)
+				continue;
+			flecs::entity parent = root.parent();
+			level.Add(root);
+			parentWorlds.Add(parent.is_valid() ? ResolveWorldTransform(parent, attributesRel, cache) : FTransform::Identity);
+		}
 
-		for (flecs::entity current = ifcObject; current.is_valid(); current = current.parent())
-			for (int32_t i = 0;; i++) {
-				flecs::entity attributes = current.target(attributesRel, i);
-				if (!attributes.is_valid())
-					break;
+		// One hierarchy level at a time, so every parent is final before its children compose with it.
+		// Flecs reads stay on the game thread, the per-level composition runs in parallel on wide levels.
+		// Only spatial objects are descended into, attribute nodes never get a WorldTransform.
+		TArray<FTransform> worlds;
+		while (level.Num() > 0) {
+			worlds.SetNum(level.Num());
+			for (int32 i = 0; i < level.Num(); ++i)
+				worlds[i] = GetLocalTransform(level[i], attributesRel, cache);
+			ParallelFor(level.Num(), [&](int32 i) {
+				worlds[i] = parentWorlds[i] * worlds[i];
+			}, level.Num() < 1024 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
 
-				int32 matId = INDEX_NONE;
-				attributes.children([&](flecs::entity attribute) {
-					if (attribute.has<Material>())
-						matId = attribute.try_get<Material>()->Value;
+			TArray<flecs::entity> next;
+			TArray<FTransform> nextParentWorlds;
+			for (int32 i = 0; i < level.Num(); ++i) {
+				level[i].set<WorldTransform>({ worlds[i] });
+				visit(level[i], worlds[i]);
+				level[i].children([&](flecs::entity child) {
+					if (!child.has<IfcObject>() || child.has<Attribute>() || child.has<AttributeContainer>())
+						return;
+					next.Add(child);
+					nextParentWorlds.Add(worlds[i]);
 				});
+			}
+			level = MoveTemp(next);
+			parentWorlds = MoveTemp(nextParentWorlds);
+		}
+	}
 
-				if (matId != INDEX_NONE)
-					return matId;
+	// Shared by every instance of the prefab owning the container, rebuilt after an attribute change removes it
+	ResolvedModel GetResolvedModel(flecs::entity attributes) {
+		if (const ResolvedModel* resolved = attributes.try_get<ResolvedModel>())
+			return *resolved;
+		ResolvedModel model;
+		attributes.children([&](flecs::entity attribute) {
+			if (attribute.has<Mesh>())
+				model.Mesh = attribute.try_get<Mesh>()->Value;
+			if (attribute.has<Material>())
+				model.Material = attribute.try_get<Material>()->Value;
+			if (const MeshFrame* frame = attribute.try_get<MeshFrame>()) {
+				model.Frame = FTransform(frame->Rotation, frame->Position);
+				model.HasFrame = true;
 			}
-		return INDEX_NONE;
-		//auto defaultMaterial = world.entity();
-		//defaultMaterial.set<Owner>({});
-		//defultMaterial.set<Material>({ 0 }); // Default material
+		});
+		attributes.set<ResolvedModel>(model);
+		return model;
+	}
+
+	// Later containers override mesh and frame, the first container with a material wins, else the nearest object above
+	EffectiveModel GetEffectiveModel(flecs::entity ifcObject, flecs::entity attributesRel) {
+		if (ifcObject.owns<EffectiveModel>())
+			return *ifcObject.try_get<EffectiveModel>();
+		EffectiveModel effective;
+		int32_t i = 0;
+		while (flecs::entity attributes = ifcObject.target(attributesRel, i++)) {
+			const ResolvedModel model = GetResolvedModel(attributes);
+			if (model.Mesh != INDEX_NONE)
+				effective.Mesh = model.Mesh;
+			if (model.HasFrame)
+				effective.Frame = model.Frame;
+			if (effective.Material == INDEX_NONE)
+				effective.Material = model.Material;
+		}
+		if (effective.Material == INDEX_NONE) {
+			flecs::entity parent = ifcObject.parent();
+			while (parent.is_valid() && !parent.has<IfcObject>())
+				parent = parent.parent();
+			if (parent.is_valid())
+				effective.Material = GetEffectiveModel(parent, attributesRel).Material;
+		}
+		ifcObject.set<EffectiveModel>(effective);
+		return effective;
+	}
+
+	int32 FindMesh(flecs::entity ifcObject, flecs::entity attributesRel, FTransform& outFrame) {
+		const EffectiveModel effective = GetEffectiveModel(ifcObject, attributesRel);
+		outFrame = effective.Frame;
+		return effective.Mesh;
+	}
+
+	int32 FindMaterial(flecs::entity ifcObject, flecs::entity attributesRel) {
+		return GetEffectiveModel(ifcObject, attributesRel).Material;
+	}
+
+	// An object that inherits its material caches the nearest object above first, so nothing below an
+	// uncached object depends on it. Objects with their own material may be cached under an uncached one,
+	// but never read it. Entities between objects hold no cache and are walked through.
+	void InvalidateEffectiveModel(flecs::entity entity) {
+		if (entity.owns<EffectiveModel>())
+			entity.remove<EffectiveModel>();
+		else if (entity.has<IfcObject>())
+			return;
+		entity.children([](flecs::entity child) { InvalidateEffectiveModel(child); });
+	}
+
+	FTransform GetInstanceTransform(flecs::world& world, flecs::entity ifcObject) {
+		FTransform meshFrame;
+		FindMesh(ifcObject, world.try_get<AttributesRelationship>()->Value, meshFrame);
+		return meshFrame * GetWorldTransform(world, ifcObject);
+	}
+
+	void PropagateTransforms(flecs::world& world) {
+		TArray<flecs::entity> dirty;
+		world.try_get<QueryTransformDirty>()->Value.each([&](flecs::entity entity) {
+			dirty.Add(entity);
+		});
+		TArray<flecs::entity> containers;
+		world.try_get<QueryAttributesDirty>()->Value.each([&](flecs::entity container) {
+			containers.Add(container);
+		});
+		// Objects without instances yet are resolved by CreateInstances
+		TSet<uint64> marked;
+		for (flecs::entity entity : dirty)
+			marked.Add(entity.id());
+		flecs::query<> users = world.try_get<QueryAttributeUsers>()->Value;
+		for (flecs::entity container : containers) {
+			container.remove<AttributesDirty>();
+			users.set_var("Attributes", container).each([&](flecs::entity object) {
+				if (object.has<Instanced>() && !marked.Contains(object.id())) {
+					marked.Add(object.id());
+					dirty.Add(object);
+				}
+			});
+		}
+		if (dirty.IsEmpty())
+			return;
+		for (flecs::entity entity : dirty)
+			entity.remove<TransformDirty>();
+
+		auto attributesRel = world.try_get<AttributesRelationship>()->Value;
+		TArray<uint64> handles;
+		TArray<FTransform> transforms;
+		UpdateWorldTransforms(world, dirty, [&](flecs::entity entity, const FTransform& worldTransform) {
+			if (!entity.owns<ISM>())
+				return;
+			FTransform meshFrame;
+			FindMesh(entity, attributesRel, meshFrame);
+			FTransform transform = meshFrame * worldTransform;
+			if (IsCollapsed(world, entity))
+				transform.SetScale3D(FVector::ZeroVector);
+			handles.Add(entity.try_get<ISM>()->Value);
+			transforms.Add(transform);
+		});
+
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		uWorld->GetSubsystem<UISMSubsystem>()->UpdateISMTransforms(handles, transforms);
+	}
+
+	void CollectSubtreeInstances(flecs::entity entity, TArray<uint64>& outHandles) {
+		if (entity.owns<ISM>())
+			outHandles.Add(entity.try_get<ISM>()->Value);
+		entity.children([&](flecs::entity child) { CollectSubtreeInstances(child, outHandles); });
+	}
+
+	void ReleaseModelResources(flecs::world& world, TArrayView<const flecs::entity> entities) {
+		TArray<uint64> handles;
+		TArray<int32> meshes;
+		TArray<int32> materials;
+		for (flecs::entity entity : entities) {
+			CollectSubtreeInstances(entity, handles);
+			if (entity.owns<Mesh>())
+				meshes.Add(entity.try_get<Mesh>()->Value);
+			if (entity.owns<Material>())
+				materials.Add(entity.try_get<Material>()->Value);
+		}
+
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		// Instances first, so groups drop their own references before the attributes' ones
+		uWorld->GetSubsystem<UISMSubsystem>()->RemoveISMs(uWorld, handles);
+		uWorld->GetSubsystem<UMeshSubsystem>()->ReleaseMany(meshes);
+		uWorld->GetSubsystem<UMaterialSubsystem>()->ReleaseMany(materials);
+	}
+
+	void CreateInstances(flecs::world& world) {
+		TArray<flecs::entity> created;
+		world.try_get<QueryNewInstances>()->Value.each([&](flecs::entity entity) {
+			created.Add(entity);
+		});
+		if (created.IsEmpty())
+			return;
+
+		// World transforms of the new subtrees, top-down over the complete hierarchy
+		TMap<uint64, FTransform> worldTransforms;
+		worldTransforms.Reserve(created.Num());
+		UpdateWorldTransforms(world, created, [&](flecs::entity entity, const FTransform& worldTransform) {
+			worldTransforms.Add(entity.id(), worldTransform);
+		});
+
+		auto attributesRel = world.try_get<AttributesRelationship>()->Value;
+		TArray<flecs::entity> owners;
+		TArray<ISMCreateRequest> requests;
+		for (flecs::entity entity : created) {
+			entity.add<Instanced>();
+			FTransform meshFrame;
+			const int32 meshId = FindMesh(entity, attributesRel, meshFrame);
+			if (meshId == INDEX_NONE)
+				continue;
+			const int32 materialId = FindMaterial(entity, attributesRel);
+			const FTransform* worldTransform = worldTransforms.Find(entity.id());
+			if (materialId == INDEX_NONE || !worldTransform)
+				continue;
+			owners.Add(entity);
+			requests.Add({ meshId, materialId, meshFrame * *worldTransform });
+		}
 
-		//ifcObject.target(attributeRelationship, 0).set<Material>({ 0 }); // Default material
-		//return 0;
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		UMeshSubsystem* meshSubsystem = uWorld->GetSubsystem<UMeshSubsystem>();
+		const MeshStreamingSettings& streaming = meshSubsystem->GetBuildSettings().Streaming;
+		if (streaming.Enabled) {
+			TArray<FBox> bounds;
+			bounds.SetNum(requests.Num());
+			for (int32 i = 0; i < requests.Num(); ++i)
+				if (const MeshEntryData* entry = meshSubsystem->FindEntry(requests[i].MeshId))
+					bounds[i] = entry->Bounds.TransformBy(requests[i].Transform);
+			for (int32 i = 0; i < requests.Num(); ++i)
+				if (!bounds[i].IsValid)
+					bounds[i] = FBox(requests[i].Transform.GetLocation(), requests[i].Transform.GetLocation());
+			AssignStreamingCells(world, streaming, owners, bounds);
+			return;
+		}
+
+		TArray<uint64> handles;
+		uWorld->GetSubsystem<UISMSubsystem>()->CreateISMs(uWorld, requests, handles);
+		for (int32 i = 0; i < owners.Num(); ++i)
+			if (handles[i] != 0)
+				owners[i].set<ISM>({ handles[i] });
+		UpdateVisibilityMasks(world, owners);
 	}
 
 	void ModelFeature::CreateComponents(flecs::world& world) {
@@ -84,69 +378,52 @@ namespace IFC {
 		world.component<Scale>().member<FVector>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
 
 		world.component<Mesh>().member<int32>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
+		world.component<MeshFrame>()
+			.member<FVector>("Position")
+			.member<FRotator>("Rotation")
+			.add(flecs::OnInstantiate, flecs::Inherit);
 		world.component<ISM>().member<uint64>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
 
 		world.component<Material>().member<int32>(VALUE).add(flecs::OnInstantiate, flecs::Inherit);
-	}
 
-	void ModelFeature::CreateObservers(flecs::world& world) {
-		world.observer<>("CreateISMOnIfcObjectCreation")
-			.with<IfcObject>()
-			.event(flecs::OnAdd)
-			.each([&](flecs::entity ifcObject) {
-			auto attributesRel = world.try_get<AttributesRelationship>()->Value;
-			int32 meshId = INDEX_NONE;
-			int32_t i = 0;
-			while (flecs::entity attributes = ifcObject.target(attributesRel, i++))
-				attributes.children([&](flecs::entity attribute) {
-				if (attribute.has<Mesh>())
-					meshId = attribute.try_get<Mesh>()->Value;
-			});
-			if (meshId == INDEX_NONE)
-				return;
-
-			int32 materialId = FindMaterial(world, ifcObject);
-			if (materialId == INDEX_NONE)
-				return;
+		world.component<WorldTransform>().add(flecs::OnInstantiate, flecs::DontInherit);
+		world.component<TransformDirty>();
+		world.component<AttributesDirty>();
+		world.component<Instanced>();
+		world.component<ResolvedModel>().add(flecs::OnInstantiate, flecs::DontInherit);
+		world.component<EffectiveModel>().add(flecs::OnInstantiate, flecs::DontInherit);
+		world.component<Loading>().add(flecs::Singleton);
+		world.component<Unloading>().add(flecs::Singleton);
+	}
 
-			FTransform worldTransform = FTransform::Identity;
-			flecs::entity current = ifcObject;
-			while (current.is_valid()) {
-				FVector	position = FVector::ZeroVector;
-				FRotator rotation = FRotator::ZeroRotator;
-				FVector scale = FVector::OneVector;
-
-				i = 0;
-				while (flecs::entity attributes = current.target(attributesRel, i++)) {
-					attributes.children([&](flecs::entity attribute) {
-						if (attribute.has<Position>())
-							position = attribute.try_get<Position>()->Value;
-						if (attribute.has<Rotation>())
-							rotation = attribute.try_get<Rotation>()->Value;
-						if (attribute.has<Scale>())
-							scale = attribute.try_get<Scale>()->Value;
-					});
-				}
+	void ModelFeature::CreateQueries(flecs::world& world) {
+		world.component<QueryTransformDirty>();
+		world.set(QueryTransformDirty{
+			world.query_builder<>(COMPONENT(QueryTransformDirty))
+			.with<TransformDirty>()
+			.cached().build() });
 
-				FTransform localTransform(rotation, position, scale);
-				worldTransform = localTransform * worldTransform;
-				current = current.parent();
-			}
+		world.component<QueryAttributesDirty>();
+		world.set(QueryAttributesDirty{
+			world.query_builder<>(COMPONENT(QueryAttributesDirty))
+			.with<AttributesDirty>()
+			.cached().build() });
 
-			UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
-			ifcObject.set<ISM>({ uWorld->GetSubsystem<UISMSubsystem>()->CreateISM(
-				uWorld,
-				meshId,
-				materialId,
-				worldTransform.GetLocation(),
-				worldTransform.Rotator(),
-				worldTransform.GetScale3D())
-				});
-		});
+		world.component<QueryNewInstances>();
+		world.set(QueryNewInstances{
+			world.query_builder<>(COMPONENT(QueryNewInstances))
+			.with<IfcObject>()
+			.without<AttributeContainer>()
+			.without<Instanced>()
+			.cached().build() });
+	}
 
+	void ModelFeature::CreateObservers(flecs::world& world) {
 		world.observer<Material>("RemoveMaterial")
 			.event(flecs::OnRemove)
 			.each([&](flecs::entity entity, Material& material) {
+			if (world.has<Unloading>())
+				return;
 			static_cast<UWorld*>(world.get_ctx())
 				->GetSubsystem<UMaterialSubsystem>()->Release(material.Value);
 		});
@@ -154,12 +431,181 @@ namespace IFC {
 		world.observer<ISM>("RemoveISM")
 			.event(flecs::OnRemove)
 			.each([&](flecs::entity entity, ISM& ism) {
+			if (world.has<Unloading>())
+				return;
 			UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
-			uWorld->GetSubsystem<UISMSubsystem>()->DestroyAll(uWorld);
+			uWorld->GetSubsystem<UISMSubsystem>()->RemoveISM(uWorld, ism.Value);
+		});
+
+		// Layer overrides that change a container's mesh or material drop its resolved model and the
+		// effective models of the objects using it
+		auto invalidateModel = [&world](flecs::entity attribute) {
+			flecs::entity attributes = attribute.parent();
+			if (!attributes.is_valid() || !attributes.owns<ResolvedModel>())
+				return;
+			attributes.remove<ResolvedModel>();
+			world.try_get<QueryAttributeUsers>()->Value.set_var("Attributes", attributes).each([](flecs::entity object) {
+				InvalidateEffectiveModel(object);
+			});
+		};
+		world.observer<Mesh>("InvalidateResolvedMesh")
+			.event(flecs::OnSet)
+			.event(flecs::OnRemove)
+			.each([invalidateModel](flecs::entity entity, Mesh&) { invalidateModel(entity); });
+		world.observer<Material>("InvalidateResolvedMaterial")
+			.event(flecs::OnSet)
+			.event(flecs::OnRemove)
+			.each([invalidateModel](flecs::entity entity, Material&) { invalidateModel(entity); });
+		world.observer<MeshFrame>("InvalidateResolvedMeshFrame")
+			.event(flecs::OnSet)
+			.event(flecs::OnRemove)
+			.each([invalidateModel](flecs::entity entity, MeshFrame&) { invalidateModel(entity); });
+
+		// Objects owning the changed transform, or the changed attribute's container, are marked and resolved
+		// in PropagateTransforms. Objects a running load creates are left to CreateInstances, overrides of
+		// existing ones are kept and propagated in EndLoad.
+		auto markDirty = [&world](flecs::entity changed) {
+			if (changed.has<IfcObject>()) {
+				if (!world.has<Loading>() || changed.has<Instanced>())
+					changed.add<TransformDirty>();
+				return;
+			}
+			flecs::entity attributes = changed.parent();
+			if (changed.has<Attribute>() && attributes.is_valid())
+				attributes.add<AttributesDirty>();
+		};
+		world.observer<Position>("MarkPositionDirty")
+			.event(flecs::OnSet)
+			.each([markDirty](flecs::entity entity, Position&) { markDirty(entity); });
+		world.observer<Rotation>("MarkRotationDirty")
+			.event(flecs::OnSet)
+			.each([markDirty](flecs::entity entity, Rotation&) { markDirty(entity); });
+		world.observer<Scale>("MarkScaleDirty")
+			.event(flecs::OnSet)
+			.each([markDirty](flecs::entity entity, Scale&) { markDirty(entity); });
+	}
+
+	void ModelFeature::CreateSystems(flecs::world& world) {
+		// Objects created outside a load; loads run the same stage in EndLoad
+		world.system("CreateInstances")
+			.kind(flecs::PreUpdate)
+			.run([](flecs::iter& it) {
+			flecs::world world = it.world();
+			if (!world.has<Loading>())
+				CreateInstances(world);
+		});
+
+		world.system("PropagateTransforms")
+			.kind(flecs::PostUpdate)
+			.run([](flecs::iter& it) {
+			flecs::world world = it.world();
+			PropagateTransforms(world);
+		});
+
+		world.system("MarkPendingGarbage")
+			.kind(flecs::OnStore)
+			.run([](flecs::iter& it) {
+			UWorld* uWorld = static_cast<UWorld*>(it.world().get_ctx());
+			uWorld->GetSubsystem<UMeshSubsystem>()->MarkPendingGarbage(GARBAGE_BUDGET_SECONDS);
+			uWorld->GetSubsystem<UMaterialSubsystem>()->MarkPendingGarbage(GARBAGE_BUDGET_SECONDS);
+		});
+
+		// After everything that writes instance data this frame
+		world.system("FlushInstanceRenderState")
+			.kind(flecs::OnStore)
+			.run([](flecs::iter& it) {
+			static_cast<UWorld*>(it.world().get_ctx())->GetSubsystem<UISMSubsystem>()->FlushRenderState();
 		});
 	}
 
 	void ModelFeature::Initialize(flecs::world& world) {
+		// Built once the relationship exists; matched through the (Attributes, container) index, so uncached
+		world.component<QueryAttributeUsers>();
+		world.set(QueryAttributeUsers{
+			world.query_builder<>(COMPONENT(QueryAttributeUsers))
+			.with(world.try_get<AttributesRelationship>()->Value, "$Attributes")
+			.build() });
+
+		// Cached objects that gain or lose a container, or move to another parent, resolve their model again.
+		// Entities created by a load have no cache yet, so the filter keeps them from dispatching.
+		world.observer("InvalidateEffectiveModelOnAttributes")
+			.with(world.try_get<AttributesRelationship>()->Value, flecs::Wildcard)
+			.with<EffectiveModel>().filter()
+			.event(flecs::OnAdd)
+			.event(flecs::OnRemove)
+			.each([](flecs::entity entity) { InvalidateEffectiveModel(entity); });
+		world.observer("InvalidateEffectiveModelOnParent")
+			.with(flecs::ChildOf, flecs::Wildcard)
+			.with<EffectiveModel>().filter()
+			.event(flecs::OnAdd)
+			.each([](flecs::entity entity) { InvalidateEffectiveModel(entity); });
+
 		CreateMaterial(world, FVector4f(1, 1, 1, 1), true); // Default material
 	}
+
+	void ModelFeature::BeginLoad(flecs::world& world, const MeshBuildSettings& settings) {
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		UMeshSubsystem* meshSubsystem = uWorld->GetSubsystem<UMeshSubsystem>();
+		world.add<Loading>();
+		// Merged batches cannot be split per streaming cell, and streamed meshes are rebuilt from the disk cache
+		MeshBuildSettings effective = settings;
+		effective.Batching.Enabled &= !settings.Streaming.Enabled;
+		effective.DiskCache.Enabled |= settings.Streaming.Enabled;
+		meshSubsystem->SetBuildSettings(effective);
+		meshSubsystem->ResetBuildStats();
+		if (effective.Batching.Enabled)
+			meshSubsystem->AddCpuConsumer(TEXT("Batching"));
+		uWorld->GetSubsystem<UMaterialSubsystem>()->SetInstancedColors(settings.InstancedColors);
+		uWorld->GetSubsystem<UMaterialSubsystem>()->SetPalette(settings.Palette);
+		uWorld->GetSubsystem<UISMSubsystem>()->SetInstancingSettings(settings.Instancing);
+		uWorld->GetSubsystem<UISMSubsystem>()->BeginBatch();
+	}
+
+	void BatchSingleInstanceObjects(flecs::world& world, const MeshBatchSettings& settings) {
+		TMap<uint64, uint64> owners;
+		world.each([&](flecs::entity entity, ISM& ism) {
+			owners.Add(ism.Value, entity.id());
+		});
+
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		TMap<uint64, uint64> batched = uWorld->GetSubsystem<UISMSubsystem>()->BatchSingleInstanceGroups(uWorld, settings, owners);
+		for (const TPair<uint64, uint64>& owner : owners)
+			if (const uint64* handle = batched.Find(owner.Key))
+				world.entity(owner.Value).set<ISM>({ *handle });
+	}
+
+	void ModelFeature::EndLoad(flecs::world& world) {
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		UMeshSubsystem* meshSubsystem = uWorld->GetSubsystem<UMeshSubsystem>();
+		// Subtrees the load moved first, so new objects compose with their parents' current transforms
+		PropagateTransforms(world);
+		CreateInstances(world);
+		uWorld->GetSubsystem<UISMSubsystem>()->EndBatch();
+		world.remove<Loading>();
+		if (meshSubsystem->GetBuildSettings().Batching.Enabled) {
+			BatchSingleInstanceObjects(world, meshSubsystem->GetBuildSettings().Batching);
+			meshSubsystem->RemoveCpuConsumer(TEXT("Batching"));
+		}
+
+		const MaterialStats materialStats = uWorld->GetSubsystem<UMaterialSubsystem>()->GetStats();
+		if (materialStats.DistinctColors > 0)
+			UE_LOG(LogTemp, Log, TEXT(">>> Material palette: %d new materials for %d distinct colors"), materialStats.CreatedMaterials, materialStats.DistinctColors);
+
+		const MeshBuildStats& stats = meshSubsystem->GetBuildStats();
+		if (stats.Meshes == 0 && stats.DiskCacheHits == 0 && stats.SharedCacheHits == 0)
+			return;
+		UE_LOG(LogTemp, Log, TEXT(">>> Built %d meshes (%d fast path, %d with LODs, %d LOD cache hits, %d disk cache hits, %d written, %d from other worlds, %d canonicalized), %lld triangles, vertices %lld -> %lld (%.1f%%)"),
+			stats.Meshes,
+			stats.FastPathMeshes,
+			stats.LodMeshes,
+			stats.LodCacheHits,
+			stats.DiskCacheHits,
+			stats.DiskCacheWrites,
+			stats.SharedCacheHits,
+			stats.CanonicalMeshes,
+			stats.Triangles,
+			stats.VerticesBefore,
+			stats.VerticesAfter,
+			stats.VerticesBefore > 0 ? 100.0 * double(stats.VerticesAfter) / double(stats.VerticesBefore) : 100.0);
+	}
 }
\ No newline at end of file
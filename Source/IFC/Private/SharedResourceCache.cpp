@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SharedResourceCache.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+USharedResourceCache* USharedResourceCache::Get() {
+    return GEngine ? GEngine->GetEngineSubsystem<USharedResourceCache>() : nullptr;
+}
+
+uint64 USharedResourceCache::MakeMeshKey(uint64 contentHash, uint32 settingsVersion) {
+    return contentHash ^ ((uint64(settingsVersion) + 1) * 0x9E3779B97F4A7C15ull);
+}
+
+UStaticMesh* USharedResourceCache::FindMesh(uint64 contentHash, uint32 settingsVersion, bool cpuAccess) const {
+    const uint64 key = MakeMeshKey(contentHash, settingsVersion);
+    const Holders* holders = MeshHolders.Find(key);
+    if (!holders || (cpuAccess && !holders->CpuAccess)) return nullptr;
+    return Meshes.FindRef(key).Get();
+}
+
+bool USharedResourceCache::AddMeshHolder(uint64 contentHash, uint32 settingsVersion, UStaticMesh* mesh, bool cpuAccess, const UWorld* world) {
+    if (contentHash == 0 || !mesh || !world) return false;
+    const uint64 key = MakeMeshKey(contentHash, settingsVersion);
+    if (const TObjectPtr<UStaticMesh>* cached = Meshes.Find(key)) {
+        if (cached->Get() != mesh) return false;
+    } else {
+        Meshes.Add(key, mesh);
+        MeshHolders.Add(key).CpuAccess = cpuAccess;
+    }
+    MeshHolders[key].Worlds.Add(world);
+    return true;
+}
+
+bool USharedResourceCache::RemoveMeshHolder(uint64 contentHash, uint32 settingsVersion, const UWorld* world) {
+    const uint64 key = MakeMeshKey(contentHash, settingsVersion);
+    Holders* holders = MeshHolders.Find(key);
+    if (!holders) return true;
+    holders->Worlds.Remove(world);
+    if (holders->Worlds.Num() > 0) return false;
+    MeshHolders.Remove(key);
+    Meshes.Remove(key);
+    return true;
+}
+
+UMaterialInstanceDynamic* USharedResourceCache::FindMaterial(uint64 contentHash) const {
+    return Materials.FindRef(contentHash).Get();
+}
+
+bool USharedResourceCache::AddMaterialHolder(uint64 contentHash, UMaterialInstanceDynamic* mid, const UWorld* world) {
+    if (contentHash == 0 || !mid || !world) return false;
+    if (const TObjectPtr<UMaterialInstanceDynamic>* cached = Materials.Find(contentHash)) {
+        if (cached->Get() != mid) return false;
+    } else {
+        Materials.Add(contentHash, mid);
+    }
+    MaterialHolders.FindOrAdd(contentHash).Worlds.Add(world);
+    return true;
+}
+
+bool USharedResourceCache::RemoveMaterialHolder(uint64 contentHash, const UWorld* world) {
+    Holders* holders = MaterialHolders.Find(contentHash);
+    if (!holders) return true;
+    holders->Worlds.Remove(world);
+    if (holders->Worlds.Num() > 0) return false;
+    MaterialHolders.Remove(contentHash);
+    Materials.Remove(contentHash);
+    return true;
+}
+
+SharedResourceStats USharedResourceCache::GetStats() const {
+    SharedResourceStats stats;
+    stats.Meshes = Meshes.Num();
+    stats.Materials = Materials.Num();
+    for (const TPair<uint64, Holders>& holders : MeshHolders) stats.SharedMeshes += holders.Value.Worlds.Num() > 1 ? 1 : 0;
+    for (const TPair<uint64, Holders>& holders : MaterialHolders) stats.SharedMaterials += holders.Value.Worlds.Num() > 1 ? 1 : 0;
+    return stats;
+}
@@ -0,0 +1,216 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "StreamingFeature.h"
+#include "AttributeFeature.h"
+#include "ModelFeature.h"
+#include "VisibilityFeature.h"
+#include "ISMSubsystem.h"
+#include "MeshSubsystem.h"
+#include "ECS.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+
+namespace IFC {
+	void StreamingFeature::CreateComponents(flecs::world& world) {
+		world.component<StreamingCells>().add(flecs::Singleton);
+		world.set(StreamingCells{});
+	}
+
+	void SetStreamingViewpoint(flecs::world& world, const FVector& location) {
+		StreamingCells* cells = world.try_get_mut<StreamingCells>();
+		cells->Viewpoint = location;
+		cells->HasViewpoint = true;
+	}
+
+	void ClearStreamingViewpoint(flecs::world& world) {
+		world.try_get_mut<StreamingCells>()->HasViewpoint = false;
+	}
+
+	bool GetViewpoint(flecs::world& world, FVector& outLocation) {
+		const StreamingCells& cells = *world.try_get<StreamingCells>();
+		if (cells.HasViewpoint) {
+			outLocation = cells.Viewpoint;
+			return true;
+		}
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		APlayerController* controller = uWorld->GetFirstPlayerController();
+		if (!controller || !controller->PlayerCameraManager)
+			return false;
+		outLocation = controller->PlayerCameraManager->GetCameraLocation();
+		return true;
+	}
+
+	// Instances are created from the resident entities, so transforms and attributes changed meanwhile are picked up
+	void CreateCellInstances(flecs::world& world, StreamingCells& cells, StreamingCell& cell, TArrayView<const flecs::entity_t> objects) {
+		auto attributesRel = world.try_get<AttributesRelationship>()->Value;
+		TArray<flecs::entity> owners;
+		TArray<ISMCreateRequest> requests;
+		for (flecs::entity_t id : objects) {
+			if (!world.is_alive(id))
+				continue;
+			flecs::entity object = world.entity(id);
+			FTransform meshFrame;
+			const int32 meshId = FindMesh(object, attributesRel, meshFrame);
+			const int32 materialId = FindMaterial(object, attributesRel);
+			if (meshId == INDEX_NONE || materialId == INDEX_NONE || object.owns<ISM>())
+				continue;
+			owners.Add(object);
+			requests.Add({ meshId, materialId, meshFrame * GetWorldTransform(world, object) });
+		}
+
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		TArray<uint64> handles;
+		uWorld->GetSubsystem<UISMSubsystem>()->CreateISMs(uWorld, requests, handles);
+		TArray<flecs::entity> created;
+		for (int32 i = 0; i < owners.Num(); ++i) {
+			if (handles[i] == 0)
+				continue;
+			owners[i].set<ISM>({ handles[i] });
+			created.Add(owners[i]);
+			cell.Instances.Add(owners[i].id(), requests[i].MeshId);
+			++cells.ResidentInstances.FindOrAdd(requests[i].MeshId);
+		}
+		UpdateVisibilityMasks(world, created);
+	}
+
+	void LoadCell(flecs::world& world, StreamingCells& cells, StreamingCell& cell) {
+		CreateCellInstances(world, cells, cell, cell.Objects);
+		cell.Resident = true;
+	}
+
+	void AssignStreamingCells(flecs::world& world, const MeshStreamingSettings& settings, TArrayView<const flecs::entity> objects, TArrayView<const FBox> bounds) {
+		StreamingCells* cells = world.try_get_mut<StreamingCells>();
+		const double cellSize = FMath::Max(settings.CellSize, 1.0);
+		TMap<FIntVector, TArray<flecs::entity_t>> added;
+		for (int32 i = 0; i < objects.Num(); ++i) {
+			const FVector center = bounds[i].GetCenter() / cellSize;
+			const FIntVector key(FMath::FloorToInt32(center.X), FMath::FloorToInt32(center.Y), FMath::FloorToInt32(center.Z));
+			StreamingCell& cell = cells->Cells.FindOrAdd(key);
+			cell.Objects.Add(objects[i].id());
+			cell.Bounds += bounds[i];
+			if (cell.Resident)
+				added.FindOrAdd(key).Add(objects[i].id());
+		}
+		// A resident cell does not load again until it is unloaded, so objects added to it get their instances now
+		for (const TPair<FIntVector, TArray<flecs::entity_t>>& cellObjects : added)
+			CreateCellInstances(world, *cells, cells->Cells[cellObjects.Key], cellObjects.Value);
+	}
+
+	// Render data of meshes without resident instances is dropped, the disk cache brings it back
+	void ReleaseResidentInstance(StreamingCells& cells, UMeshSubsystem* meshSubsystem, int32 meshId) {
+		int32* count = cells.ResidentInstances.Find(meshId);
+		if (!count || --*count > 0)
+			return;
+		cells.ResidentInstances.Remove(meshId);
+		meshSubsystem->StreamOut(meshId);
+	}
+
+	void UnloadCell(flecs::world& world, StreamingCells& cells, StreamingCell& cell) {
+		TArray<uint64> handles;
+		TArray<flecs::entity> owners;
+		for (flecs::entity_t id : cell.Objects) {
+			if (!world.is_alive(id))
+				continue;
+			flecs::entity object = world.entity(id);
+			if (!object.owns<ISM>())
+				continue;
+			handles.Add(object.try_get<ISM>()->Value);
+			owners.Add(object);
+		}
+
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		uWorld->GetSubsystem<UISMSubsystem>()->RemoveISMs(uWorld, handles);
+		world.add<Unloading>();
+		world.defer_begin();
+		for (flecs::entity object : owners)
+			object.remove<ISM>();
+		world.defer_end();
+		world.remove<Unloading>();
+
+		UMeshSubsystem* meshSubsystem = uWorld->GetSubsystem<UMeshSubsystem>();
+		for (const TPair<flecs::entity_t, int32>& instance : cell.Instances)
+			ReleaseResidentInstance(cells, meshSubsystem, instance.Value);
+		cell.Instances.Reset();
+		cell.Resident = false;
+	}
+
+	void PruneStreamingCells(flecs::world& world) {
+		StreamingCells& cells = *world.try_get_mut<StreamingCells>();
+		UMeshSubsystem* meshSubsystem = static_cast<UWorld*>(world.get_ctx())->GetSubsystem<UMeshSubsystem>();
+		for (auto it = cells.Cells.CreateIterator(); it; ++it) {
+			StreamingCell& cell = it.Value();
+			cell.Objects.RemoveAll([&world](flecs::entity_t id) { return !world.is_alive(id); });
+			for (auto instance = cell.Instances.CreateIterator(); instance; ++instance) {
+				if (world.is_alive(instance.Key()))
+					continue;
+				ReleaseResidentInstance(cells, meshSubsystem, instance.Value());
+				instance.RemoveCurrent();
+			}
+			if (cell.Objects.IsEmpty())
+				it.RemoveCurrent();
+		}
+	}
+
+	void UpdateStreaming(flecs::world& world, const MeshStreamingSettings& settings) {
+		FVector viewpoint;
+		if (!GetViewpoint(world, viewpoint))
+			return;
+		StreamingCells& cells = *world.try_get_mut<StreamingCells>();
+
+		struct Candidate {
+			FIntVector Key;
+			double Distance;
+		};
+		TArray<Candidate> load;
+		TArray<Candidate> resident;
+		const double loadDistance = settings.LoadDistance * settings.LoadDistance;
+		const double unloadDistance = FMath::Max(settings.UnloadDistance, settings.LoadDistance);
+		for (const TPair<FIntVector, StreamingCell>& cell : cells.Cells) {
+			const double distance = cell.Value.Bounds.ComputeSquaredDistanceToPoint(viewpoint);
+			if (cell.Value.Resident)
+				resident.Add({ cell.Key, distance });
+			else if (distance <= loadDistance)
+				load.Add({ cell.Key, distance });
+		}
+
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		UMeshSubsystem* meshSubsystem = uWorld->GetSubsystem<UMeshSubsystem>();
+		int32 budget = FMath::Max(settings.MaxCellsPerFrame, 1);
+
+		// Farthest first, past the hysteresis band or, while over the memory budget, anywhere outside the
+		// load radius. Cells inside it are never evicted, the budget cannot empty the view.
+		resident.Sort([](const Candidate& a, const Candidate& b) { return a.Distance > b.Distance; });
+		for (const Candidate& candidate : resident) {
+			const bool far = candidate.Distance > unloadDistance * unloadDistance;
+			if (budget == 0 || candidate.Distance <= loadDistance
+				|| (!far && meshSubsystem->GetStreamableBytes() <= settings.MemoryBudget))
+				break;
+			UnloadCell(world, cells, cells.Cells[candidate.Key]);
+			--budget;
+		}
+
+		// Nearest first; cells inside the load radius always load
+		load.Sort([](const Candidate& a, const Candidate& b) { return a.Distance < b.Distance; });
+		for (const Candidate& candidate : load) {
+			if (budget == 0)
+				break;
+			LoadCell(world, cells, cells.Cells[candidate.Key]);
+			--budget;
+		}
+	}
+
+	void StreamingFeature::CreateSystems(flecs::world& world) {
+		// After CreateInstances, so cells assigned this frame can load in the same frame
+		world.system("UpdateStreaming")
+			.kind(flecs::PreUpdate)
+			.run([](flecs::iter& it) {
+			flecs::world world = it.world();
+			if (world.has<Loading>())
+				return;
+			UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+			const MeshStreamingSettings& settings = uWorld->GetSubsystem<UMeshSubsystem>()->GetBuildSettings().Streaming;
+			if (settings.Enabled)
+				UpdateStreaming(world, settings);
+		});
+	}
+}
@@ -0,0 +1,210 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "VisibilityFeature.h"
+#include "AttributeFeature.h"
+#include "LayerFeature.h"
+#include "ModelFeature.h"
+#include "ISMSubsystem.h"
+#include "MaterialSubsystem.h"
+#include "ECS.h"
+
+namespace IFC {
+	void VisibilityFeature::CreateComponents(flecs::world& world) {
+		using namespace ECS;
+
+		world.component<VisibilityMask>().member<uint32>(VALUE);
+		world.component<VisibilityCategories>().add(flecs::Singleton);
+		world.set(VisibilityCategories{});
+	}
+
+	// What an object carries to fall in one category
+	struct CategoryTest {
+		uint32 Bit = 0;
+		InternedString Layer; // Layer path, compared with the inherited Owner
+		flecs::id_t Class = 0;
+		flecs::id_t System = 0; // (PartOfSystem, system)
+	};
+
+	TArray<CategoryTest> GetCategoryTests(flecs::world& world, const VisibilityCategories& categories) {
+		TArray<CategoryTest> tests;
+		for (const TPair<uint64, int32>& category : categories.Bits) {
+			if (!world.is_alive(category.Key))
+				continue;
+			flecs::entity entity = world.entity(category.Key);
+			CategoryTest test;
+			test.Bit = 1u << category.Value;
+			if (entity.has<Layer>()) {
+				test.Layer = GetLayerOwner(entity);
+			} else {
+				test.Class = entity.id();
+				test.System = world.pair<PartOfSystem>(entity);
+			}
+			tests.Add(test);
+		}
+		return tests;
+	}
+
+	uint32 ComputeVisibilityMask(flecs::world& world, flecs::entity object, TArrayView<const CategoryTest> tests) {
+		uint32 mask = 0;
+		if (const Owner* owner = object.try_get<Owner>())
+			for (const CategoryTest& test : tests)
+				if (!test.Layer.IsEmpty() && owner->Value == test.Layer)
+					mask |= test.Bit;
+
+		auto attributesRel = world.try_get<AttributesRelationship>()->Value;
+		int32_t i = 0;
+		while (flecs::entity attributes = object.target(attributesRel, i++))
+			attributes.children([&](flecs::entity attribute) {
+			for (const CategoryTest& test : tests)
+				if (test.Layer.IsEmpty() && (attribute.has(test.Class) || attribute.has(test.System)))
+					mask |= test.Bit;
+		});
+		return mask;
+	}
+
+	bool UsesMaterialTest(UWorld* uWorld) {
+		return uWorld->GetSubsystem<UMaterialSubsystem>()->HasVisibilityCollection()
+			&& uWorld->GetSubsystem<UISMSubsystem>()->GetInstancingSettings().VisibilityMasks;
+	}
+
+	// Without the material-side test hidden instances are collapsed to zero scale, batched objects are hidden
+	void ApplyVisibility(flecs::world& world, TArrayView<const flecs::entity> objects, uint32 hiddenMask) {
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		UISMSubsystem* ismSubsystem = uWorld->GetSubsystem<UISMSubsystem>();
+		TArray<uint64> handles;
+		TArray<FTransform> transforms;
+		TArray<uint64> batchedHandles;
+		TArray<bool> batchedHidden;
+		for (flecs::entity object : objects) {
+			const ISM* ism = object.try_get<ISM>();
+			const VisibilityMask* mask = object.try_get<VisibilityMask>();
+			if (!ism || !mask)
+				continue;
+			const bool hidden = (mask->Value & hiddenMask) != 0;
+			if (UISMSubsystem::IsBatchHandle(ism->Value)) {
+				batchedHandles.Add(ism->Value);
+				batchedHidden.Add(hidden);
+				continue;
+			}
+			FTransform transform = GetInstanceTransform(world, object);
+			if (hidden)
+				transform.SetScale3D(FVector::ZeroVector);
+			handles.Add(ism->Value);
+			transforms.Add(transform);
+		}
+		ismSubsystem->UpdateISMTransforms(handles, transforms);
+		ismSubsystem->SetBatchedObjectsHidden(uWorld, batchedHandles, batchedHidden);
+	}
+
+	void UpdateVisibilityMasks(flecs::world& world, TArrayView<const flecs::entity> objects) {
+		const VisibilityCategories& categories = *world.try_get<VisibilityCategories>();
+		if (categories.Bits.IsEmpty())
+			return;
+		const uint32 hiddenMask = categories.Hidden;
+		TArray<CategoryTest> tests = GetCategoryTests(world, categories);
+
+		TArray<ISMCustomDataUpdate> updates;
+		TArray<flecs::entity> hidden;
+		for (flecs::entity object : objects) {
+			const uint32 mask = ComputeVisibilityMask(world, object, tests);
+			object.set<VisibilityMask>({ mask });
+			if (const ISM* ism = object.try_get<ISM>())
+				updates.Add({ ism->Value, UISMSubsystem::VisibilityMaskChannel, float(mask) });
+			if (mask & hiddenMask)
+				hidden.Add(object);
+		}
+
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		uWorld->GetSubsystem<UISMSubsystem>()->SetISMCustomDataBulk(updates);
+		if (!UsesMaterialTest(uWorld))
+			ApplyVisibility(world, hidden, hiddenMask);
+	}
+
+	bool SetCategoryVisible(flecs::world& world, flecs::entity category, bool visible) {
+		VisibilityCategories* categories = world.try_get_mut<VisibilityCategories>();
+		bool added = false;
+		if (!categories->Bits.Contains(category.id())) {
+			if (categories->Bits.Num() >= MAX_VISIBILITY_CATEGORIES) {
+				UE_LOG(LogTemp, Warning, TEXT(">>> Visibility categories exhausted (%d)"), MAX_VISIBILITY_CATEGORIES);
+				return false;
+			}
+			// Lowest free bit, removed categories leave gaps
+			uint32 used = 0;
+			for (const TPair<uint64, int32>& existing : categories->Bits)
+				used |= 1u << existing.Value;
+			categories->Bits.Add(category.id(), FMath::CountTrailingZeros(~used));
+			added = true;
+		}
+
+		const uint32 bit = 1u << categories->Bits[category.id()];
+		const uint32 hiddenMask = visible ? categories->Hidden & ~bit : categories->Hidden | bit;
+		if (!added && hiddenMask == categories->Hidden)
+			return true;
+		categories->Hidden = hiddenMask;
+
+		TArray<flecs::entity> objects;
+		world.each([&](flecs::entity object, ISM& ism) {
+			if (added || (object.has<VisibilityMask>() && (object.try_get<VisibilityMask>()->Value & bit)))
+				objects.Add(object);
+		});
+
+		// A new category needs every mask rebuilt, which also collapses what it hides
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		if (added)
+			UpdateVisibilityMasks(world, objects);
+		if (UsesMaterialTest(uWorld))
+			return uWorld->GetSubsystem<UMaterialSubsystem>()->SetHiddenMask(uWorld, hiddenMask);
+		if (!added)
+			ApplyVisibility(world, objects, hiddenMask);
+		return true;
+	}
+
+	void RemoveVisibilityCategories(flecs::world& world, TArrayView<const flecs::entity> removed) {
+		VisibilityCategories* categories = world.try_get_mut<VisibilityCategories>();
+		uint32 bits = 0;
+		for (flecs::entity category : removed)
+			if (const int32* bit = categories->Bits.Find(category.id())) {
+				bits |= 1u << *bit;
+				categories->Bits.Remove(category.id());
+			}
+		if (bits == 0)
+			return;
+		const bool wasHidden = (categories->Hidden & bits) != 0;
+		categories->Hidden &= ~bits;
+		const uint32 hiddenMask = categories->Hidden;
+
+		// Survivors drop the freed bits, so a category reusing one starts from clean masks
+		TArray<flecs::entity> objects;
+		TArray<ISMCustomDataUpdate> updates;
+		world.each([&](flecs::entity object, VisibilityMask& mask) {
+			if ((mask.Value & bits) == 0)
+				return;
+			mask.Value &= ~bits;
+			objects.Add(object);
+			if (const ISM* ism = object.try_get<ISM>())
+				updates.Add({ ism->Value, UISMSubsystem::VisibilityMaskChannel, float(mask.Value) });
+		});
+
+		UWorld* uWorld = static_cast<UWorld*>(world.get_ctx());
+		uWorld->GetSubsystem<UISMSubsystem>()->SetISMCustomDataBulk(updates);
+		if (!wasHidden)
+			return;
+		if (UsesMaterialTest(uWorld))
+			uWorld->GetSubsystem<UMaterialSubsystem>()->SetHiddenMask(uWorld, hiddenMask);
+		else
+			ApplyVisibility(world, objects, hiddenMask);
+	}
+
+	bool IsCollapsed(flecs::world& world, flecs::entity object) {
+		const VisibilityMask* mask = object.try_get<VisibilityMask>();
+		if (!mask || (mask->Value & world.try_get<VisibilityCategories>()->Hidden) == 0)
+			return false;
+		return !UsesMaterialTest(static_cast<UWorld*>(world.get_ctx()));
+	}
+
+	bool IsCategoryVisible(flecs::world& world, flecs::entity category) {
+		const VisibilityCategories& categories = *world.try_get<VisibilityCategories>();
+		const int32* bit = categories.Bits.Find(category.id());
+		return !bit || (categories.Hidden & (1u << *bit)) == 0;
+	}
+}
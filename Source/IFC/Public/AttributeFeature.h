@@ -3,8 +3,9 @@
 #pragma once
 
 #include <flecs.h>
-#include "rapidjson/document.h"
+#include "JsonDocument.h"
 #include "ECS.h"
+#include "InternedString.h"
 
 namespace IFC {
 	struct AttributeFeature {
@@ -46,7 +47,8 @@ namespace IFC {
 	struct AttributesRelationship { flecs::entity Value; };
 
 	struct Attribute {};
-	struct Value { FString Value; };
+	struct AttributeContainer {}; // Carries IfcObject for layer queries, but is not part of the spatial hierarchy
+	struct Value { InternedString Value; };
 
 	// Entities
 	struct Alignment {};
@@ -98,5 +100,5 @@ namespace IFC {
 	};
 
 	IFC_API TArray<flecs::entity> GetAttributes(flecs::world& world, flecs::entity ifcObject);
-	TTuple<FString, FString, FString> GetAttributes(flecs::world& world, const rapidjson::Value& object, const FString& objectPath);
+	TTuple<FString, FString, FString> GetAttributes(flecs::world& world, const JsonValue& object, const FString& objectPath);
 }
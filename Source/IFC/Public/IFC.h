@@ -9,6 +9,9 @@
 #include "rapidjson/error/en.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
+#include "JsonDocument.h"
+#include "MeshBuildSettings.h"
+#include "InternedString.h"
 
 class FIFCModule : public IModuleInterface {
 public:
@@ -34,7 +37,7 @@ namespace IFC {
 	IFC_API FString CleanName(const FString& in);
 	FString MakeId(const FString& in);
 
-	IFC_API void LoadIfcData(flecs::world& world, const TArray<flecs::entity> layers);
+	IFC_API void LoadIfcData(flecs::world& world, const TArray<flecs::entity> layers, const MeshBuildSettings& settings = MeshBuildSettings());
 #pragma endregion
 
 #pragma region Flecs
@@ -42,8 +45,8 @@ namespace IFC {
 
 	IFC_API void Register(flecs::world& world);
 
-	struct Id { FString Value; };
-	struct Name { FString Value; };
+	struct Id { InternedString Value; };
+	struct Name { InternedString Value; };
 	struct IfcObject {};
 
 	struct Root {};
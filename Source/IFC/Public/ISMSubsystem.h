@@ -2,8 +2,63 @@
 
 #include "CoreMinimal.h"
 #include "Subsystems/WorldSubsystem.h"
+#include "MeshOptimizer.h"
+#include "SlotMap.h"
 #include "ISMSubsystem.generated.h"
 
+class UStaticMeshComponent;
+
+// Instances of one mesh sharing one material, or one blend mode in instanced-color mode
+struct ISMGroup {
+    int32 MeshId = INDEX_NONE;
+    int32 MaterialKey = INDEX_NONE; // Material id, or a negative key per instanced master
+    TArray<int32> InstanceMaterials; // Instanced-color mode only, in instance order
+    TArray<int32> InstanceSlots; // Instance index -> handle slot, including queued instances
+};
+
+// Handle indirection: handles name a slot and its generation, the slot tracks the current instance index
+struct ISMSlot {
+    int32 GroupId = INDEX_NONE;
+    int32 InstanceIndex = INDEX_NONE;
+    uint32 Generation = 1;
+};
+
+struct ISMCreateRequest {
+    int32 MeshId = INDEX_NONE;
+    int32 MaterialId = INDEX_NONE;
+    FTransform Transform;
+};
+
+struct ISMCustomDataUpdate {
+    uint64 Handle = 0;
+    int32 Channel = 0;
+    float Value = 0;
+};
+
+// Per-instance buffers of one group: transforms, custom data and handle slots
+struct ISMGroupMemory {
+    int32 MeshId = INDEX_NONE;
+    int32 MaterialKey = INDEX_NONE;
+    int32 Instances = 0;
+    SIZE_T Bytes = 0;
+};
+
+struct ISMBatchRange {
+    uint64 Owner = 0;
+    int32 FirstTriangle = 0;
+    int32 NumTriangles = 0;
+    FBoxSphereBounds Bounds = FBoxSphereBounds(ForceInit);
+    bool Hidden = false;
+};
+
+struct ISMBatch {
+    int32 MeshId = INDEX_NONE;
+    int32 MaterialId = INDEX_NONE;
+    FVector Origin = FVector::ZeroVector;
+    TArray<uint32> Indices; // Merged indices as built; hidden ranges are zeroed in the uploaded copy
+    TArray<ISMBatchRange> Ranges;
+};
+
 UCLASS()
 class UISMSubsystem : public UWorldSubsystem {
     GENERATED_BODY()
@@ -11,21 +66,98 @@ class UISMSubsystem : public UWorldSubsystem {
 public:
 
     IFC_API void SetISMCustomData(uint64 handle, int32 customIndex, float value);
+    // Bulk writes only touch channels inside the reserved layout and return the number of values written.
+    // Like every update here they defer the render state update to FlushRenderState. Game thread only.
+    IFC_API int32 SetISMCustomDataBulk(TArrayView<const ISMCustomDataUpdate> updates);
+    // One value per instance of the group, in instance order
+    IFC_API int32 SetISMGroupCustomData(int32 groupId, int32 channel, TArrayView<const float> values);
+    // Marks every component touched since the last flush dirty once and uploads the index buffer of every
+    // batch whose hidden ranges changed; run once per frame.
+    void FlushRenderState();
 
-    static uint64 MakeIsmHandle(int32 meshId, int32 instanceIndex);
-    static void SplitIsmHandle(uint64 id, int32& outMeshId, int32& outInstanceIndex);
+    // Fixed custom data layout, so instanced colors, visibility masks and user data never share a channel.
+    // RGBA, then offset, of instanced-color groups
+    static constexpr int32 InstancedColorFloats = 5;
+    // Category bits of the instance, tested against the hidden mask of the visibility collection
+    static constexpr int32 VisibilityMaskChannel = InstancedColorFloats;
+    // First of the MeshInstancingSettings::CustomDataFloats channels
+    static constexpr int32 UserCustomDataChannel = VisibilityMaskChannel + 1;
+
+    static uint64 MakeIsmHandle(int32 slot, uint32 generation);
+    static void SplitIsmHandle(uint64 id, int32& outSlot, uint32& outGeneration);
+    static uint64 MakeBatchHandle(int32 batchId, int32 rangeIndex);
+    static bool IsBatchHandle(uint64 handle);
 
     uint64 CreateISM(UWorld* world, int32 meshId, int32 materialId, const FVector& position, const FRotator& rotation, const FVector& scale);
+    // Queues every request and adds each group's share with one AddInstances; outHandles matches requests, 0 on failure.
+    void CreateISMs(UWorld* world, TArrayView<const ISMCreateRequest> requests, TArray<uint64>& outHandles);
+    // Between BeginBatch and EndBatch CreateISM only queues transforms; EndBatch adds them with one
+    // AddInstances per component. Handles are the same as unbatched calls would return.
+    void BeginBatch();
+    void EndBatch();
+    void SetInstancingSettings(const MeshInstancingSettings& settings);
+    const MeshInstancingSettings& GetInstancingSettings() const { return Instancing; }
+    TArray<ISMGroupMemory> GetGroupMemory() const;
     bool UpdateISMTransform(uint64 id, const FTransform& transform, bool worldSpace = true, bool markRenderStateDirty = true, bool teleport = true);
-    bool SetISMNumCustomDataFloats(int32 meshId, int32 numFloats);
-    int32 GetISMInstanceCount(int32 meshId) const;
-    void DestroyGroup(UWorld* world, int32 meshId);
+    // World space. Returns the number of instances updated; batched objects cannot move and are skipped with a warning.
+    int32 UpdateISMTransforms(TArrayView<const uint64> handles, TArrayView<const FTransform> transforms, bool teleport = true);
+    bool SetISMNumCustomDataFloats(int32 groupId, int32 numFloats);
+    int32 GetISMInstanceCount(int32 groupId) const;
+    void DestroyGroup(UWorld* world, int32 groupId);
+    // Swap-removes one instance; every other handle stays valid. Batched objects are hidden instead.
+    bool RemoveISM(UWorld* world, uint64 handle);
+    // Same result as removing one by one, but fills each group's holes from its tail and trims the tail once,
+    // and rebuilds each touched batch once. Returns the number removed.
+    int32 RemoveISMs(UWorld* world, TArrayView<const uint64> handles);
+    bool ResolveHandle(uint64 handle, int32& outGroupId, int32& outInstanceIndex) const;
     void DestroyAll(UWorld* world);
     IFC_API FBoxSphereBounds GetBounds(uint64 id);
+
+    // Merges single-instance groups into per-material meshes per spatial cell.
+    // owners maps ISM handles to flecs entity ids; returns the new handle for every merged one.
+    TMap<uint64, uint64> BatchSingleInstanceGroups(UWorld* world, const MeshBatchSettings& settings, const TMap<uint64, uint64>& owners);
+    IFC_API bool FindBatchedObject(const UPrimitiveComponent* component, int32 faceIndex, uint64& outHandle, uint64& outOwner) const;
+    IFC_API bool GetBatchedRange(uint64 handle, UStaticMeshComponent*& outComponent, int32& outFirstTriangle, int32& outNumTriangles) const;
+    // Takes effect in FlushRenderState, with one index upload per batch however many objects changed
+    IFC_API bool SetBatchedObjectHidden(UWorld* world, uint64 handle, bool hidden);
+    // One hidden flag per handle; each touched batch is uploaded once. Returns the number of ranges changed.
+    IFC_API int32 SetBatchedObjectsHidden(UWorld* world, TArrayView<const uint64> handles, TArrayView<const bool> hidden);
 private:
     AActor* EnsureRoot(UWorld* world);
-    UInstancedStaticMeshComponent* GetOrCreateIsm(UWorld* world, int32 meshId, int32 materialId);
+    int32 GetOrCreateGroup(UWorld* world, int32 meshId, int32 materialId);
+    int32 AllocateSlot(int32 groupId, int32 instanceIndex);
+    void FreeSlot(int32 slot);
+    uint64 GetHandle(int32 groupId, int32 instanceIndex) const;
+    bool FindBatchRange(uint64 handle, int32& outBatchId, int32& outRangeIndex) const;
+    void UploadBatchIndices(int32 batchId);
+    void DestroyBatch(UWorld* world, int32 batchId);
+    void FlushPending(int32 groupId);
+    bool ShouldBeHierarchical(const UInstancedStaticMeshComponent* ism, int32 instanceCount) const;
+    UInstancedStaticMeshComponent* ConvertToHierarchical(int32 groupId);
+    TObjectPtr<UInstancedStaticMeshComponent>* FindGroup(int32 groupId);
+    UInstancedStaticMeshComponent* GetGroupComponent(int32 groupId) const;
+
+    static constexpr int32 InstancedOpaqueKey = -2;
+    static constexpr int32 InstancedTranslucentKey = -3;
+
+    struct PendingGroup {
+        TArray<FTransform> Transforms;
+        TArray<float> CustomData;
+    };
 
     UPROPERTY() TObjectPtr<AActor> Root;
-    UPROPERTY() TMap<int32, TObjectPtr<UInstancedStaticMeshComponent>> ByMeshId;
+    UPROPERTY() TArray<TObjectPtr<UInstancedStaticMeshComponent>> Groups; // By slot index of GroupData
+    TSlotMap<ISMGroup> GroupData;
+    TMap<TTuple<int32, int32>, int32> GroupByKey; // (mesh, material key) -> group
+    TMap<int32, PendingGroup> PendingInstances;
+    TArray<ISMSlot> Slots;
+    TArray<int32> FreeSlots;
+    TSet<int32> DirtyGroups; // Render state updates deferred to FlushRenderState
+    bool Batching = false;
+    MeshInstancingSettings Instancing;
+
+    UPROPERTY() TMap<int32, TObjectPtr<UStaticMeshComponent>> BatchComponents;
+    TMap<int32, ISMBatch> Batches;
+    TSet<int32> DirtyBatches; // Index uploads deferred to FlushRenderState
+    int32 NextBatchId = 1;
 };
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <flecs.h>
+
+namespace IFC {
+	// Handle to an immutable string in a shared pool. Equal strings (case-sensitive) share one entry,
+	// so they are stored once and compare as integers. Entries are reference counted by their handles
+	// and freed with the last one, so removed layers and destroyed worlds give their strings back.
+	// Interning, copying and reading are thread-safe.
+	struct IFC_API InternedString {
+		InternedString() = default;
+		explicit InternedString(const FString& value);
+		explicit InternedString(const TCHAR* value) : InternedString(FString(value)) {}
+		InternedString(const InternedString& other);
+		InternedString(InternedString&& other) : Index(other.Index) { other.Index = 0; }
+		InternedString& operator=(const InternedString& other);
+		InternedString& operator=(InternedString&& other);
+		~InternedString();
+
+		const FString& ToString() const;
+		const TCHAR* operator*() const { return *ToString(); }
+		operator const FString&() const { return ToString(); }
+		bool IsEmpty() const { return Index == 0; }
+
+		friend bool operator==(const InternedString& a, const InternedString& b) { return a.Index == b.Index; }
+		friend bool operator!=(const InternedString& a, const InternedString& b) { return a.Index != b.Index; }
+		friend uint32 GetTypeHash(const InternedString& value) { return value.Index; }
+
+		// Live unique strings and their heap bytes
+		static void GetPoolStats(int32& outCount, SIZE_T& outBytes);
+		// Opaque string reflection, so scripts and tools read and assign it like an FString member
+		static void Register(flecs::world& world);
+
+	private:
+		uint32 Index = 0; // 0 is the empty string
+	};
+}
@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "rapidjson/document.h"
+
+namespace IFC {
+	// rapidjson base allocator on FMemory instead of the CRT, so LLM sees parsed documents under the active tag
+	struct JsonAllocator {
+		static const bool kNeedFree = true;
+
+		void* Malloc(size_t size) {
+			return size ? FMemory::Malloc(size) : nullptr;
+		}
+
+		void* Realloc(void* original, size_t originalSize, size_t newSize) {
+			if (newSize == 0) {
+				FMemory::Free(original);
+				return nullptr;
+			}
+			return FMemory::Realloc(original, newSize);
+		}
+
+		static void Free(void* ptr) {
+			FMemory::Free(ptr);
+		}
+
+		bool operator==(const JsonAllocator&) const { return true; }
+		bool operator!=(const JsonAllocator&) const { return false; }
+	};
+
+	using JsonDocument = rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<JsonAllocator>, JsonAllocator>;
+	using JsonValue = rapidjson::GenericValue<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<JsonAllocator>>;
+}
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "ECS.h"
+#include "InternedString.h"
 #include <flecs.h>
 
 namespace IFC {
@@ -15,18 +16,23 @@ namespace IFC {
 	constexpr const char* OWNER = COMPONENT(Owner);
 
 	struct Layer {};
-	struct Path { FString Value; };
+	struct Path { InternedString Value; };
 	struct IfcxVersion { FString Value; };
 	struct DataVersion { FString Value; };
 	struct Author { FString Value; };
 	struct Timestamp { FString Value; };
 
-	struct Owner { FString Value; };
+	struct Owner { InternedString Value; };
 
 	struct QueryLayers { flecs::query<> Value; };
 
 	FString GetOwnerPath(const FString& layerPath);
+	// Owner value of everything the layer contributed: the layer's full path
+	InternedString GetLayerOwner(flecs::entity layer);
 
 	IFC_API void AddLayers(flecs::world& world, const TArray<FString>& paths, const TArray<FString>& components);
+	// Deletes everything the layers contributed through their Owner prefabs, releasing instances,
+	// meshes and materials in bulk. Entities shared with other layers stay.
+	IFC_API void RemoveLayers(flecs::world& world, const TArray<flecs::entity>& layers);
 	IFC_API FString CleanLayerName(const FString& in);
 }
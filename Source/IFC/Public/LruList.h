@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SlotMap.h"
+
+// Links of one entry in a TLruList, stored in the entry itself
+struct LruLink {
+    int32 Prev = INDEX_NONE;
+    int32 Next = INDEX_NONE;
+    bool Linked = false;
+};
+
+// Least recently used order over TSlotMap handles, threaded through an LruLink member named Lru.
+// Linking, unlinking and finding the oldest entry are O(1) and allocate nothing.
+template <typename T>
+class TLruList {
+public:
+    // Appends as the most recently used; an entry already linked is moved to the back
+    void PushBack(TSlotMap<T>& entries, int32 handle) {
+        T& entry = entries[handle];
+        if (entry.Lru.Linked) Remove(entries, handle);
+        entry.Lru.Prev = Tail;
+        entry.Lru.Next = INDEX_NONE;
+        entry.Lru.Linked = true;
+        if (Tail != INDEX_NONE) entries[Tail].Lru.Next = handle;
+        else Head = handle;
+        Tail = handle;
+        ++Count;
+    }
+
+    void Remove(TSlotMap<T>& entries, int32 handle) {
+        T& entry = entries[handle];
+        if (!entry.Lru.Linked) return;
+        if (entry.Lru.Prev != INDEX_NONE) entries[entry.Lru.Prev].Lru.Next = entry.Lru.Next;
+        else Head = entry.Lru.Next;
+        if (entry.Lru.Next != INDEX_NONE) entries[entry.Lru.Next].Lru.Prev = entry.Lru.Prev;
+        else Tail = entry.Lru.Prev;
+        entry.Lru = LruLink();
+        --Count;
+    }
+
+    // Least recently used handle, INDEX_NONE when empty
+    int32 Front() const { return Head; }
+    int32 Num() const { return Count; }
+
+private:
+    int32 Head = INDEX_NONE;
+    int32 Tail = INDEX_NONE;
+    int32 Count = 0;
+};
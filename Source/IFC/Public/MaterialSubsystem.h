@@ -4,12 +4,40 @@
 
 #include "CoreMinimal.h"
 #include "Subsystems/WorldSubsystem.h"
+#include "MeshBuildSettings.h"
+#include "SlotMap.h"
+#include "LruList.h"
 #include "MaterialSubsystem.generated.h"
 
+class UMaterialParameterCollection;
+
+// Color of a material entry in instanced-color mode, written to per-instance custom data
+struct MaterialInstanceData {
+    FVector4f Color = FVector4f(1, 1, 1, 1);
+    float Offset = 0.0f;
+    bool Opaque = true;
+};
+
 struct MaterialEntryData {
     int32 RefCount = 0;
     uint64 ContentHash = 0;
     double LastAccess = 0.0;
+    SIZE_T Bytes = 0;
+    bool Instanced = false;
+    bool Shared = false; // Held through USharedResourceCache
+    MaterialInstanceData Instance;
+    LruLink Lru; // Linked while unreferenced and cached
+};
+
+struct MaterialStats {
+    int32 Count = 0;
+    int32 TotalRefCount = 0;
+    int32 CachedCount = 0; // Unreferenced, kept for reuse until evicted
+    SIZE_T Bytes = 0;
+    SIZE_T CachedBytes = 0;
+    int32 MidCount = 0;
+    int32 DistinctColors = 0; // Exact color and offset combinations requested since SetPalette
+    int32 CreatedMaterials = 0; // Materials those requests added, without ones already loaded
 };
 
 UCLASS()
@@ -21,25 +49,88 @@ class UMaterialSubsystem : public UWorldSubsystem {
         
         MOpaque = LoadObject<UMaterialInterface>(nullptr, OpaquePath);
         MTranslucent = LoadObject<UMaterialInterface>(nullptr, TranslucentPath);
+        MInstancedOpaque = LoadObject<UMaterialInterface>(nullptr, InstancedOpaquePath);
+        MInstancedTranslucent = LoadObject<UMaterialInterface>(nullptr, InstancedTranslucentPath);
+        MVisibility = LoadObject<UMaterialParameterCollection>(nullptr, VisibilityPath);
     }
 
+    virtual void Deinitialize() override;
+
 public:
-    int32 CreateMaterial(UWorld* world, const FVector4f& rgba, float offset);
+    // A reservedId from ReserveId is filled, or cancelled when an equal material already exists
+    int32 CreateMaterial(UWorld* world, const FVector4f& rgba, float offset, int32 reservedId = INDEX_NONE);
+    // Any thread. Ids are generational handles, stale ones resolve to nothing.
+    int32 ReserveId() { return EntryData.Reserve(); }
+    void CancelReservedId(int32 id) { EntryData.Cancel(id); }
     void Retain(int32 id);
     void Release(int32 id);
+    // Releases one reference per entry and trims the cache once
+    void ReleaseMany(TArrayView<const int32> ids);
+    // Evicted MIDs are marked as garbage here instead of on eviction, for at most budgetSeconds per call
+    int32 MarkPendingGarbage(double budgetSeconds);
     UMaterialInstanceDynamic* Get(int32 id) const;
+    MaterialStats GetStats() const;
+    const MaterialEntryData* FindEntry(int32 id) const { return EntryData.Find(id); }
+
+    // Unreferenced materials stay cached until their size exceeds the budget, least recently used first.
+    // Referenced materials do not count towards it.
+    void SetCacheBudget(SIZE_T bytes);
+    SIZE_T GetCacheBudget() const { return CacheBudget; }
+    void TrimCache(SIZE_T budget);
+
+    // Instanced colors: new materials become per-instance custom data on two shared masters instead of one MID each.
+    // Returns false when the instanced masters are missing.
+    bool SetInstancedColors(bool enabled);
+    bool IsInstanced(int32 id) const { return FindInstanceData(id) != nullptr; }
+    const MaterialInstanceData* FindInstanceData(int32 id) const {
+        const MaterialEntryData* entry = EntryData.Find(id);
+        return entry && entry->Instanced ? &entry->Instance : nullptr;
+    }
+    UMaterialInterface* GetInstancedMaster(bool opaque) const { return opaque ? MInstancedOpaque : MInstancedTranslucent; }
+    // For consumers without per-instance data, creates the MID of an instanced entry on first use
+    UMaterialInstanceDynamic* GetOrCreateMid(UWorld* world, int32 id);
+
+    // Quantizes colors of new materials and clears the distinct color count used for the palette report
+    void SetPalette(const MaterialPaletteSettings& settings);
+
+    // Shared hidden category mask read by materials that test the instance visibility mask channel.
+    // Returns false when the visibility collection is missing.
+    bool HasVisibilityCollection() const { return MVisibility != nullptr; }
+    bool SetHiddenMask(UWorld* world, uint32 mask);
 
 private:
-    static uint64 MakeHash(UMaterialInterface* master, const FVector4f& rgba, bool opaque);
-    int32 Register(UMaterialInstanceDynamic* mid, uint64 contentHash);
+    static uint64 MakeHash(UMaterialInterface* master, const FVector4f& rgba, float offset, bool opaque);
+    FVector4f Quantize(const FVector4f& rgba) const;
+    int32 Register(UMaterialInstanceDynamic* mid, uint64 contentHash, int32 reservedId);
+    TObjectPtr<UMaterialInstanceDynamic>& MidSlot(int32 id);
+    bool ReleaseShared(const MaterialEntryData& entry); // True when no other world holds the MID
+    bool ReleaseReference(int32 id); // True when the entry became unreferenced and cached
+    void Cache(int32 id);
+    void Uncache(int32 id);
+    void Evict(int32 id);
 
     const TCHAR* OpaquePath = TEXT("/Game/Materials/Opaque.Opaque");
     const TCHAR* TranslucentPath = TEXT("/Game/Materials/Translucent.Translucent");
+    const TCHAR* InstancedOpaquePath = TEXT("/Game/Materials/OpaqueInstanced.OpaqueInstanced");
+    const TCHAR* InstancedTranslucentPath = TEXT("/Game/Materials/TranslucentInstanced.TranslucentInstanced");
+    const TCHAR* VisibilityPath = TEXT("/Game/Materials/Visibility.Visibility");
     UPROPERTY(Transient) TObjectPtr<UMaterialInterface> MOpaque = nullptr;
     UPROPERTY(Transient) TObjectPtr<UMaterialInterface> MTranslucent = nullptr;
-    UPROPERTY(Transient) TMap<int32, TObjectPtr<UMaterialInstanceDynamic>> Materials;
+    UPROPERTY(Transient) TObjectPtr<UMaterialInterface> MInstancedOpaque = nullptr;
+    UPROPERTY(Transient) TObjectPtr<UMaterialInterface> MInstancedTranslucent = nullptr;
+    UPROPERTY(Transient) TObjectPtr<UMaterialParameterCollection> MVisibility = nullptr;
+    UPROPERTY(Transient) TArray<TObjectPtr<UMaterialInstanceDynamic>> Materials; // By slot index of EntryData
+    UPROPERTY(Transient) TArray<TObjectPtr<UMaterialInstanceDynamic>> PendingGarbage;
 
-    TMap<int32, MaterialEntryData> EntryData;
+    TSlotMap<MaterialEntryData> EntryData;
     TMap<uint64, int32> HashToId;
-    int32 NextId = 1;
+    int32 MidCount = 0;
+    bool InstancedColors = false;
+    MaterialPaletteSettings Palette;
+    TSet<uint64> RequestedColors;
+    int32 CreatedMaterials = 0;
+    TLruList<MaterialEntryData> Cached;
+    SIZE_T TotalBytes = 0;
+    SIZE_T CachedBytes = 0;
+    SIZE_T CacheBudget = SIZE_T(16) * 1024 * 1024;
 };
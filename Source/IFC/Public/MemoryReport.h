@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <flecs.h>
+#include "MemoryTags.h"
+#include "MeshSubsystem.h"
+#include "MaterialSubsystem.h"
+#include "ISMSubsystem.h"
+
+namespace IFC {
+	struct LayerMemory {
+		FString Layer;
+		int32 Entities = 0;
+		SIZE_T StringBytes = 0; // Owned string component handles, the text lives in the shared pool
+		int32 Meshes = 0;
+		SIZE_T MeshBytes = 0;
+		int32 Materials = 0;
+		SIZE_T MaterialBytes = 0;
+		int32 Instances = 0;
+	};
+
+	struct ComponentMemory {
+		FString Component;
+		int32 Count = 0;
+		SIZE_T Bytes = 0;
+	};
+
+	struct MemoryReport {
+		TArray<LayerMemory> Layers;
+		TArray<ComponentMemory> Components;
+		TArray<ISMGroupMemory> Groups; // Largest first
+		MeshStats Meshes;
+		MaterialStats Materials;
+		int32 InternedStrings = 0; // Process-wide, shared by every world
+		SIZE_T InternedBytes = 0;
+	};
+
+	// Resident memory of one world by layer, string component and instance group.
+	// Meshes and materials used by several layers count towards each of them.
+	IFC_API MemoryReport GetMemoryReport(flecs::world& world);
+	IFC_API void LogMemoryReport(flecs::world& world, int32 maxGroups = 20);
+	// Makes the world reachable from the IFC.Memory.Report console command until it is destroyed
+	void RegisterMemoryReport(flecs::world& world);
+}
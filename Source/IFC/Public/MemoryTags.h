@@ -0,0 +1,13 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "HAL/LowLevelMemTracker.h"
+
+// Low-level memory tracker tags, shown with -llm and in the LLM stat pages
+LLM_DECLARE_TAG_API(IFC_Json, IFC_API); // rapidjson DOMs while loading, allocated through JsonAllocator
+LLM_DECLARE_TAG_API(IFC_Script, IFC_API); // Generated flecs script
+LLM_DECLARE_TAG_API(IFC_Entities, IFC_API); // Entities and components created from the script
+LLM_DECLARE_TAG_API(IFC_Meshes, IFC_API);
+LLM_DECLARE_TAG_API(IFC_Materials, IFC_API);
+LLM_DECLARE_TAG_API(IFC_Instances, IFC_API);
@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct MeshOptimizationSettings {
+    bool Weld = true;
+    bool OptimizeVertexCache = true;
+    bool OptimizeOverdraw = true;
+    bool OptimizeVertexFetch = true;
+    int32 VertexCacheSize = 16;
+    float OverdrawThreshold = 1.05f; // Allowed ACMR degradation when reordering clusters for overdraw
+};
+
+struct MeshLodSettings {
+    bool Enabled = false;
+    int32 MinTriangles = 20000; // Only meshes above this get LOD1..N
+    int32 MaxLods = 3;
+    float TriangleRatio = 0.5f; // Triangle count of each LOD relative to the previous one
+    float MaxError = 2.0f; // Per LOD step, in cm
+    float FirstScreenSize = 0.3f;
+    float ScreenSizeRatio = 0.5f;
+    int64 CacheBytes = int64(256) * 1024 * 1024; // Simplified LODs kept after their mesh is released, oldest dropped first
+};
+
+// Merges single-instance meshes sharing a material into one mesh per spatial cell
+struct MeshBatchSettings {
+    bool Enabled = false;
+    double CellSize = 5000.0; // cm
+    int32 MaxObjectTriangles = 2000; // Larger objects keep their own component for culling
+    int32 MaxBatchVertices = 1 << 20;
+};
+
+struct MeshStorageSettings {
+    bool Compact = false;
+    int32 PositionBits = 16; // CPU-side copies are quantized to this grid over the mesh bounds; 0 keeps floats
+    bool ReleaseCpuData = true; // Drop CPU copies once render resources exist, unless a CPU consumer is registered
+};
+
+// Groups above the threshold switch to hierarchical instancing for per-cluster culling
+struct MeshInstancingSettings {
+    bool Hierarchical = false;
+    int32 HierarchicalThreshold = 2048;
+    int32 CustomDataFloats = 0; // Reserved on every group at creation from UISMSubsystem::UserCustomDataChannel on, so bulk writes never resize
+    bool VisibilityMasks = false; // Reserves the visibility mask channel for the material-side test
+};
+
+// Colors are snapped to a grid before materials are shared, so exporter float noise does not split them
+struct MaterialPaletteSettings {
+    bool Enabled = false;
+    int32 Levels = 256; // Per channel, 256 matches 8-bit colors
+};
+
+// Instances are partitioned into cells and only cells near the camera keep ISM instances and mesh render data
+struct MeshStreamingSettings {
+    bool Enabled = false; // Disables merged batching, batches cannot be split per cell, and enables the disk cache
+    double CellSize = 20000.0; // cm
+    double LoadDistance = 100000.0; // cm, to the cell bounds
+    double UnloadDistance = 120000.0; // Above LoadDistance so cells at the edge do not flicker
+    int32 MaxCellsPerFrame = 4;
+    SIZE_T MemoryBudget = SIZE_T(1024) * 1024 * 1024; // Streamable mesh render data; cells outside LoadDistance go first when exceeded
+};
+
+// Moves baked world-space geometry into a canonical local frame before hashing so copies share one mesh
+struct MeshCanonicalizationSettings {
+    bool Enabled = false;
+    float Tolerance = 0.05f; // Canonical points snap to this grid, in cm
+    float AxisTolerance = 0.01f; // Minimum relative gap between principal variances for the axes to be trusted
+};
+
+// Optimized mesh buffers persisted across sessions, see MeshDiskCache
+struct MeshDiskCacheSettings {
+    bool Enabled = false;
+    FString Directory; // Empty = Saved/IFC/MeshCache
+    int64 MaxBytes = int64(2) * 1024 * 1024 * 1024;
+    int64 MaxEntryBytes = int64(64) * 1024 * 1024; // Larger meshes are rebuilt every time
+};
+
+struct MeshBuildSettings {
+    MeshOptimizationSettings Optimization;
+    MeshLodSettings Lods;
+    MeshBatchSettings Batching;
+    MeshStorageSettings Storage;
+    MeshDiskCacheSettings DiskCache;
+    MeshCanonicalizationSettings Canonicalization;
+    MeshInstancingSettings Instancing;
+    MeshStreamingSettings Streaming;
+    bool FastPath = true; // Fill render buffers directly instead of going through FMeshDescription
+    int32 FastPathMaxTriangles = 512; // Larger meshes take the full build; 0 = no limit
+    bool MikkTSpaceTangents = false; // Requires the full build
+    bool InstancedColors = false; // Colors as per-instance custom data on shared masters instead of one material each
+    MaterialPaletteSettings Palette;
+};
+
+struct MeshBuildStats {
+    int32 Meshes = 0;
+    int64 VerticesBefore = 0;
+    int64 VerticesAfter = 0;
+    int64 Triangles = 0;
+    int32 FastPathMeshes = 0;
+    int32 LodMeshes = 0;
+    int32 LodCacheHits = 0;
+    int32 DiskCacheHits = 0;
+    int32 DiskCacheWrites = 0;
+    int32 SharedCacheHits = 0; // Built by another world
+    int32 CanonicalMeshes = 0; // Placed through a rotated frame; translation-only ones are not counted
+};
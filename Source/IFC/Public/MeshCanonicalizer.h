@@ -0,0 +1,12 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MeshBuildSettings.h"
+
+// Moves points into their centroid and principal axes frame, so rigidly moved copies hash alike
+struct MeshCanonicalizer {
+    // False when only the centroid was removed, e.g. for symmetric shapes
+    static bool Canonicalize(TArray<FVector3f>& points, const MeshCanonicalizationSettings& settings, FTransform& outFrame);
+};
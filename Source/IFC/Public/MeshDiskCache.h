@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MeshOptimizer.h"
+
+// Optimized LOD buffers on disk, keyed by content hash and build settings version.
+// Entries are the final inputs of the render buffer fill, so a hit skips expansion,
+// optimization and simplification. Game thread only.
+class MeshDiskCache {
+public:
+    static FString GetDefaultDirectory();
+    static uint32 ComputeSettingsVersion(const MeshBuildSettings& settings);
+    static void Clear(const FString& directory);
+
+    void Configure(const MeshDiskCacheSettings& settings, uint32 settingsVersion);
+    bool IsEnabled() const { return Settings.Enabled; }
+
+    bool Load(uint64 contentHash, TArray<MeshBuffers>& outLods) const;
+    bool Contains(uint64 contentHash) const;
+    bool Store(uint64 contentHash, TArrayView<const MeshBuffers> lods);
+    // Deletes least recently used entries until the directory fits in budget bytes.
+    void Trim(int64 budget);
+    void Clear();
+
+private:
+    FString GetPath(uint64 contentHash) const;
+    void ScanDirectory();
+
+    MeshDiskCacheSettings Settings;
+    FString Directory;
+    uint32 SettingsVersion = 0;
+    int64 TotalBytes = -1; // -1 until the directory has been scanned
+};
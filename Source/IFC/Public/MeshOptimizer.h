@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MeshBuildSettings.h"
+#include "Math/Vector2DHalf.h"
+
+struct MeshBuffers {
+    TArray<FVector3f> Positions;
+    TArray<FVector3f> Normals;
+    TArray<FVector2f> UVs;
+    TArray<uint32> Indices;
+
+    int32 NumVertices() const { return Positions.Num(); }
+    int32 NumTriangles() const { return Indices.Num() / 3; }
+};
+
+// Long-lived CPU copy of MeshBuffers: positions quantized over the bounds, packed normals,
+// half UVs when their range allows it and 16-bit indices when they fit.
+struct CompactMeshBuffers {
+    FVector3f BoundsMin = FVector3f::ZeroVector;
+    FVector3f BoundsSize = FVector3f::ZeroVector;
+    int32 PositionBits = 0;
+    int32 NumVertices = 0;
+    TArray<uint16> QuantizedPositions; // 3 per vertex when PositionBits > 0
+    TArray<FVector3f> Positions; // When PositionBits == 0
+    TArray<uint32> Normals; // Signed 8 bits per axis
+    TArray<FVector2DHalf> HalfUVs;
+    TArray<FVector2f> UVs; // When the UV range does not fit half precision
+    TArray<uint16> Indices16;
+    TArray<uint32> Indices32;
+
+    static CompactMeshBuffers Pack(const MeshBuffers& buffers, int32 positionBits);
+    MeshBuffers Unpack() const;
+    SIZE_T GetAllocatedSize() const;
+};
+
+// Pure functions over MeshBuffers, safe to call from any thread.
+struct MeshOptimizer {
+    // One flat-shaded vertex per triangle corner, with face normals and planar UVs.
+    static MeshBuffers Expand(const TArray<FVector3f>& points, const TArray<int32>& indices);
+
+    static void Weld(MeshBuffers& buffers);
+    static void OptimizeVertexCache(MeshBuffers& buffers, int32 cacheSize);
+    static void OptimizeOverdraw(MeshBuffers& buffers, int32 cacheSize, float threshold);
+    static void OptimizeVertexFetch(MeshBuffers& buffers);
+    static void Optimize(MeshBuffers& buffers, const MeshOptimizationSettings& settings);
+
+    static float ComputeAcmr(const TArray<uint32>& indices, int32 cacheSize);
+
+    // True when every UV survives a half-float round trip within tolerance
+    static bool FitsHalfPrecisionUVs(const TArray<FVector2f>& uvs, float tolerance = 1.0f / 256.0f);
+};
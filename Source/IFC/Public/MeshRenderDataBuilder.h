@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MeshOptimizer.h"
+
+class FStaticMeshRenderData;
+struct FStaticMeshLODResources;
+
+// Builds FStaticMeshRenderData straight from MeshBuffers, skipping FMeshDescription and
+// BuildFromMeshDescriptions. Build is safe to call from any thread; the result is handed
+// to a UStaticMesh on the game thread.
+struct MeshRenderDataBuilder {
+    static bool NeedsFullBuild(const MeshBuffers& buffers, const MeshBuildSettings& settings);
+    static TUniquePtr<FStaticMeshRenderData> Build(const MeshBuffers& buffers, bool compact = false, bool needsCpuAccess = true);
+    // lods[0] is the base mesh; screenSizes has one entry per LOD. Compact builds skip the
+    // vertex color stream and use half-precision UVs when they fit.
+    static TUniquePtr<FStaticMeshRenderData> Build(TArrayView<const MeshBuffers> lods, TArrayView<const float> screenSizes, bool compact = false, bool needsCpuAccess = true);
+    // Reads CPU-side buffers back; fails when the LOD was built without CPU access.
+    static bool Read(const FStaticMeshLODResources& lod, MeshBuffers& outBuffers);
+};
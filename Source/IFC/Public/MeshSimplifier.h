@@ -0,0 +1,12 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Quadric error edge collapse; vertices on open or non-manifold edges stay locked
+struct MeshSimplifier {
+    static void Simplify(const TArray<FVector3f>& points, const TArray<int32>& indices,
+        int32 targetTriangles, float maxError,
+        TArray<FVector3f>& outPoints, TArray<int32>& outIndices);
+};
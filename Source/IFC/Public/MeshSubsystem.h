@@ -6,17 +6,31 @@
 #include "Subsystems/WorldSubsystem.h"
 #include "UObject/ObjectPtr.h"
 #include "Engine/StaticMesh.h"
+#include "MeshOptimizer.h"
+#include "MeshDiskCache.h"
+#include "SlotMap.h"
+#include "LruList.h"
 #include "MeshSubsystem.generated.h"
 
 struct MeshEntryData {
     int32 RefCount = 0;
     uint64 ContentHash = 0;
     double LastAccess = 0.0;
+    bool CpuAccess = true;
+    SIZE_T Bytes = 0;
+    FBox Bounds = FBox(ForceInit); // Kept while the render data is streamed out
+    bool Shared = false; // Held through USharedResourceCache
+    uint32 SettingsVersion = 0; // Build settings version it was built or registered with, part of its shared cache key
+    bool Streamable = false; // Registered by a streaming load, built from the disk cache on first use
+    LruLink Lru; // Linked while unreferenced and cached
 };
 
 struct MeshStats {
     int32 Count = 0;
     int32 TotalRefCount = 0;
+    int32 CachedCount = 0; // Unreferenced, kept for reuse until evicted
+    SIZE_T Bytes = 0;
+    SIZE_T CachedBytes = 0;
 };
 
 UCLASS()
@@ -24,18 +38,97 @@ class UMeshSubsystem : public UWorldSubsystem {
     GENERATED_BODY()
 
 public:
+    virtual void Deinitialize() override;
+
+    static uint64 ComputeContentHash(const TArray<FVector3f>& points, const TArray<int32>& indices);
+
     int32 CreateMesh(UWorld* world, const TArray<FVector3f>& points, const TArray<int32>& indices); 
-    int32 RegisterMesh(UStaticMesh* mesh, uint64 contentHash);
+    // A reservedId from ReserveId is filled, or cancelled when the content is already registered
+    int32 RegisterMesh(UStaticMesh* mesh, uint64 contentHash, bool cpuAccess = true, int32 reservedId = INDEX_NONE);
+    // exactLayout keeps vertex and triangle order as given, for meshes addressed by face index
+    int32 CreateMesh(const MeshBuffers& buffers, uint64 contentHash, bool exactLayout = false);
+    bool ReadBuffers(int32 id, MeshBuffers& outBuffers) const;
+    // Game thread only; renderData may come from MeshRenderDataBuilder::Build on a worker.
+    int32 RegisterRenderData(TUniquePtr<FStaticMeshRenderData> renderData, uint64 contentHash, bool cpuAccess, int32 reservedId = INDEX_NONE);
+    // Any thread. Ids are generational handles, stale ones resolve to nothing.
+    int32 ReserveId() { return EntryData.Reserve(); }
+    void CancelReservedId(int32 id) { EntryData.Cancel(id); }
     bool TryFindByHash(uint64 contentHash, int32& outId) const;
     void Retain(int32 id);
     void Release(int32 id, bool destroyNow = false);
+    // Releases one reference per entry and trims the cache once
+    void ReleaseMany(TArrayView<const int32> ids);
+    // Meshes evicted with destroyNow are marked as garbage here, for at most budgetSeconds per call
+    int32 MarkPendingGarbage(double budgetSeconds);
     UStaticMesh* Get(int32 id) const;
+    // Streaming: drops the render data of a streamable mesh whose LODs are in the disk cache, keeping its
+    // id and references. GetResident rebuilds it from the cache on demand.
+    bool StreamOut(int32 id);
+    UStaticMesh* GetResident(int32 id);
     void Touch(int32 id);
     MeshStats GetStats() const;
+    // Render data of resident streamable meshes, what the streaming memory budget counts
+    SIZE_T GetStreamableBytes() const { return StreamableBytes; }
+    const MeshEntryData* FindEntry(int32 id) const { return EntryData.Find(id); }
+
+    // Unreferenced meshes stay cached until their size exceeds the budget, least recently used first.
+    // Referenced meshes do not count towards it.
+    void SetCacheBudget(SIZE_T bytes);
+    SIZE_T GetCacheBudget() const { return CacheBudget; }
+    void TrimCache(SIZE_T budget);
+
+    void SetBuildSettings(const MeshBuildSettings& settings);
+    const MeshBuildSettings& GetBuildSettings() const { return Settings; }
+    // Everything that shapes the render data, so worlds with different settings never share a mesh
+    uint32 GetBuildSettingsVersion() const { return BuildSettingsVersion; }
+    const MeshBuildStats& GetBuildStats() const { return BuildStats; }
+    void ResetBuildStats();
+    void CountCanonicalMesh() { ++BuildStats.CanonicalMeshes; }
+    void ClearLodCache();
+    MeshDiskCache& GetDiskCache() { return DiskCache; }
+
+    // Meshes built while a consumer is registered keep their CPU-side buffers in compact mode
+    void AddCpuConsumer(FName consumer);
+    void RemoveCpuConsumer(FName consumer);
+    bool NeedsCpuAccess() const;
+    bool HasCpuAccess(int32 id) const;
 
 private:
-    UPROPERTY() TMap<int32, TObjectPtr<UStaticMesh>> Meshes;
-    TMap<int32, MeshEntryData> EntryData;
+    TArray<float> MakeScreenSizes(int32 numLods) const;
+    void GenerateLods(uint64 contentHash, const TArray<FVector3f>& points, const TArray<int32>& indices, TArray<MeshBuffers>& lods);
+    UStaticMesh* BuildMesh(TArrayView<const MeshBuffers> lods, TArrayView<const float> screenSizes, bool cpuAccess);
+    int32 BuildAndRegister(TArrayView<const MeshBuffers> lods, TArrayView<const float> screenSizes, uint64 contentHash);
+    // Entry without render data, for meshes whose LODs are in the disk cache
+    int32 RegisterStreamedOut(uint64 contentHash, const FBox& bounds);
+    UStaticMesh* BuildStaticMesh(TArrayView<const MeshBuffers> lods, TArrayView<const float> screenSizes, bool cpuAccess);
+    UStaticMesh* CreateStaticMesh(TUniquePtr<FStaticMeshRenderData> renderData);
+    void Evict(int32 id, bool destroyNow);
+    bool ReleaseReference(int32 id, bool destroyNow); // True when the entry became unreferenced and cached
+    void Cache(int32 id);
+    void Uncache(int32 id);
+    TObjectPtr<UStaticMesh>& MeshSlot(int32 id);
+    bool TryRegisterShared(uint64 contentHash, bool cpuAccess, int32 reservedId, int32& outId);
+    bool ReleaseShared(const MeshEntryData& entry); // True when no other world holds the mesh
+
+    UPROPERTY() TArray<TObjectPtr<UStaticMesh>> Meshes; // By slot index of EntryData
+    UPROPERTY() TArray<TObjectPtr<UStaticMesh>> PendingGarbage;
+    TSlotMap<MeshEntryData> EntryData;
     TMap<uint64, int32> HashToId;
-    int32 NextId = 1;
+    TLruList<MeshEntryData> Cached;
+    SIZE_T TotalBytes = 0;
+    SIZE_T CachedBytes = 0;
+    SIZE_T StreamableBytes = 0;
+    SIZE_T CacheBudget = SIZE_T(512) * 1024 * 1024;
+
+    MeshBuildSettings Settings;
+    MeshBuildStats BuildStats;
+    using LodCacheKey = TTuple<uint64, uint32>; // Content hash, LOD settings version
+    void TrimLodCache();
+    TMap<LodCacheKey, TArray<CompactMeshBuffers>> LodCache; // LOD1..N, kept across releases
+    TArray<LodCacheKey> LodCacheOrder; // Oldest first
+    SIZE_T LodCacheBytes = 0;
+    uint32 LodSettingsVersion = 0;
+    uint32 BuildSettingsVersion = 0;
+    TSet<FName> CpuConsumers;
+    MeshDiskCache DiskCache;
 };
\ No newline at end of file
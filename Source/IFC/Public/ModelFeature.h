@@ -3,25 +3,76 @@
 #pragma once
 
 #include <flecs.h>
+#include "MeshBuildSettings.h"
 
 namespace IFC {
 	struct ModelFeature {
 		static void CreateComponents(flecs::world& world);
+		static void CreateQueries(flecs::world& world);
 		static void CreateObservers(flecs::world& world);
+		static void CreateSystems(flecs::world& world);
 		static void Initialize(flecs::world& world);
+		static void BeginLoad(flecs::world& world, const MeshBuildSettings& settings);
+		static void EndLoad(flecs::world& world);
 	};
 
 	constexpr const float TO_CM = 100;
+	constexpr const double GARBAGE_BUDGET_SECONDS = 0.001; // Per frame, for evicted meshes and materials
 
 	struct Position { FVector Value; };
 	struct Rotation { FRotator Value; };
 	struct Scale { FVector Value; };
 
 	struct Mesh { int32 Value; };
+	struct MeshFrame { FVector Position; FRotator Rotation; }; // Canonical mesh space relative to the object
 	struct ISM { uint64 Value; };
 	struct Material { int32 Value; };
 
+	struct WorldTransform { FTransform Value; }; // Cached, refreshed when the object or an ancestor moves
+	struct TransformDirty {}; // Own or attribute transform changed since the last propagation
+	struct AttributesDirty {}; // On a container whose transform attributes changed since the last propagation
+	struct Loading {}; // Singleton while a load is running, transforms are resolved at creation then
+	struct Unloading {}; // Singleton while an unload releases resources in bulk instead of per removal
+	// Own mesh, mesh frame and material of one attribute container, cached on the container
+	struct ResolvedModel {
+		int32 Mesh = INDEX_NONE;
+		int32 Material = INDEX_NONE;
+		bool HasFrame = false;
+		FTransform Frame = FTransform::Identity;
+	};
+	// Effective mesh, mesh frame and material of one object after container overrides and material
+	// inheritance from its parents, cached on the object and dropped when a container or parent changes
+	struct EffectiveModel {
+		int32 Mesh = INDEX_NONE;
+		int32 Material = INDEX_NONE;
+		FTransform Frame = FTransform::Identity;
+	};
+	struct Instanced {}; // Instance creation ran for this object, with or without a mesh
+	struct QueryTransformDirty { flecs::query<> Value; };
+	struct QueryAttributesDirty { flecs::query<> Value; };
+	struct QueryAttributeUsers { flecs::query<> Value; }; // Objects referencing the container bound to $Attributes
+	struct QueryNewInstances { flecs::query<> Value; };
+
 	FTransform ToTransform(const float values[4][4]);
-	int32 CreateMesh(flecs::world& world, TArray<FVector3f> points, TArray<int32> indices);
+	int32 CreateMesh(flecs::world& world, TArray<FVector3f> points, TArray<int32> indices, FTransform& outFrame);
 	int32 CreateMaterial(flecs::world& world, const FVector4f& rgba, float offset);
+	// Effective mesh of the object and its canonical frame, from its attribute containers
+	int32 FindMesh(flecs::entity ifcObject, flecs::entity attributesRel, FTransform& outFrame);
+	// Nearest material up the hierarchy
+	int32 FindMaterial(flecs::entity ifcObject, flecs::entity attributesRel);
+	// Drops the cached effective models of the object and the descendants inheriting its material
+	void InvalidateEffectiveModel(flecs::entity entity);
+	// Cached world transform, resolved and cached up the hierarchy on a miss
+	IFC_API FTransform GetWorldTransform(flecs::world& world, flecs::entity entity);
+	// World transform of the object's instance, including the canonical mesh frame
+	FTransform GetInstanceTransform(flecs::world& world, flecs::entity ifcObject);
+	// Recomputes WorldTransform of roots and their spatial subtrees one hierarchy level at a time, visiting each
+	void UpdateWorldTransforms(flecs::world& world, TArrayView<const flecs::entity> roots, TFunctionRef<void(flecs::entity, const FTransform&)> visit);
+	// Recomputes the world transforms below every dirty object and updates their instances in one batch.
+	void PropagateTransforms(flecs::world& world);
+	// Removes the instances of the entities and their subtrees in bulk and releases the meshes and
+	// materials their attributes hold in one pass each. Call before deleting them with Unloading set.
+	void ReleaseModelResources(flecs::world& world, TArrayView<const flecs::entity> entities);
+	// Resolves mesh, material and world transform of every new object and creates their instances in one request.
+	void CreateInstances(flecs::world& world);
 }
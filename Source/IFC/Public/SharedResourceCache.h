@@ -0,0 +1,59 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/EngineSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "SharedResourceCache.generated.h"
+
+class UStaticMesh;
+class UMaterialInstanceDynamic;
+
+struct SharedResourceStats {
+    int32 Meshes = 0;
+    int32 Materials = 0;
+    int32 SharedMeshes = 0; // Held by more than one world
+    int32 SharedMaterials = 0;
+};
+
+// Meshes by content hash and build settings version, MIDs by content hash, shared by every world of the engine so the editor world, PIE and
+// extra viewports showing the same model build them once. World subsystems keep their own ids and
+// ref counts and hold one share per entry; the last world to let go decides whether it is destroyed.
+// Shared objects are outered to the cache, so they never keep a world alive.
+// Game thread only.
+UCLASS()
+class USharedResourceCache : public UEngineSubsystem {
+    GENERATED_BODY()
+
+public:
+    static USharedResourceCache* Get();
+
+    // Cached mesh for the content built with the same settings, nullptr when none is cached or it lacks
+    // the CPU access asked for. settingsVersion is UMeshSubsystem's build settings version.
+    UStaticMesh* FindMesh(uint64 contentHash, uint32 settingsVersion, bool cpuAccess) const;
+    // Adds the world as a holder, caching the mesh when none is yet. False when another mesh is cached for the key.
+    bool AddMeshHolder(uint64 contentHash, uint32 settingsVersion, UStaticMesh* mesh, bool cpuAccess, const UWorld* world);
+    // True when no world holds the mesh anymore; it is dropped from the cache then
+    bool RemoveMeshHolder(uint64 contentHash, uint32 settingsVersion, const UWorld* world);
+
+    UMaterialInstanceDynamic* FindMaterial(uint64 contentHash) const;
+    bool AddMaterialHolder(uint64 contentHash, UMaterialInstanceDynamic* mid, const UWorld* world);
+    bool RemoveMaterialHolder(uint64 contentHash, const UWorld* world);
+
+    SharedResourceStats GetStats() const;
+
+private:
+    // Both parts folded into one 64-bit key, which stays as collision-safe as the content hash
+    static uint64 MakeMeshKey(uint64 contentHash, uint32 settingsVersion);
+
+    struct Holders {
+        TSet<TObjectKey<UWorld>> Worlds;
+        bool CpuAccess = true;
+    };
+
+    UPROPERTY(Transient) TMap<uint64, TObjectPtr<UStaticMesh>> Meshes; // By MakeMeshKey
+    UPROPERTY(Transient) TMap<uint64, TObjectPtr<UMaterialInstanceDynamic>> Materials;
+    TMap<uint64, Holders> MeshHolders;
+    TMap<uint64, Holders> MaterialHolders;
+};
@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+// Dense storage addressed by generational handles: the low bits index a slot, the high bits hold the
+// slot's generation, so a handle to a removed and reused slot no longer resolves.
+// Handles are positive and never 0 or INDEX_NONE.
+// Everything except Reserve is game thread only. Reserve hands out slots lock-free from any thread,
+// first from a pool the game thread tops up with removed slots, then fresh ones. The game thread
+// fills them with Commit or gives them back with Cancel.
+template <typename T>
+class TSlotMap {
+public:
+    static constexpr int32 IndexBits = 20;
+    static constexpr uint32 IndexMask = (1u << IndexBits) - 1;
+    static constexpr uint32 MaxGeneration = (1u << (31 - IndexBits)) - 1;
+
+    static int32 IndexOf(int32 handle) { return int32(uint32(handle) & IndexMask); }
+
+    int32 Reserve() {
+        uint64 top = PoolTop.load(std::memory_order_acquire);
+        while (uint32(top) > 0) {
+            const int32 handle = Pool[uint32(top) - 1].load(std::memory_order_relaxed);
+            // The tag in the high half changes on every push and pop, so a stale top never matches
+            if (PoolTop.compare_exchange_weak(top, PoolState(top >> 32, uint32(top) - 1), std::memory_order_acquire))
+                return handle;
+        }
+        const int32 index = NextFresh.fetch_add(1, std::memory_order_relaxed);
+        check(uint32(index) <= IndexMask);
+        return MakeHandle(index, 1);
+    }
+
+    T& Commit(int32 handle, T&& value) {
+        const int32 index = IndexOf(handle);
+        if (index >= Slots.Num()) Slots.SetNum(index + 1);
+        Slot& slot = Slots[index];
+        check(!slot.Occupied && MakeHandle(index, slot.Generation) == handle);
+        slot.Value = MoveTemp(value);
+        slot.Occupied = true;
+        ++Count;
+        return slot.Value;
+    }
+
+    void Cancel(int32 handle) {
+        const int32 index = IndexOf(handle);
+        if (index >= Slots.Num()) Slots.SetNum(index + 1);
+        if (Slots[index].Occupied || MakeHandle(index, Slots[index].Generation) != handle) return;
+        Retire(index);
+    }
+
+    int32 Add(T&& value) {
+        const int32 handle = FreeList.Num() > 0 ? TakeFree() : Reserve();
+        Commit(handle, MoveTemp(value));
+        return handle;
+    }
+
+    T* Find(int32 handle) {
+        const int32 index = IndexOf(handle);
+        if (handle <= 0 || index >= Slots.Num()) return nullptr;
+        Slot& slot = Slots[index];
+        return slot.Occupied && MakeHandle(index, slot.Generation) == handle ? &slot.Value : nullptr;
+    }
+
+    const T* Find(int32 handle) const { return const_cast<TSlotMap*>(this)->Find(handle); }
+    bool Contains(int32 handle) const { return Find(handle) != nullptr; }
+    T& operator[](int32 handle) { T* value = Find(handle); check(value); return *value; }
+    const T& operator[](int32 handle) const { const T* value = Find(handle); check(value); return *value; }
+
+    bool Remove(int32 handle, T* outValue = nullptr) {
+        T* value = Find(handle);
+        if (!value) return false;
+        if (outValue) *outValue = MoveTemp(*value);
+        *value = T();
+        Slots[IndexOf(handle)].Occupied = false;
+        --Count;
+        Retire(IndexOf(handle));
+        return true;
+    }
+
+    int32 Num() const { return Count; }
+    // Highest slot index in use plus one, for arrays kept in parallel by IndexOf
+    int32 GetSlotCount() const { return Slots.Num(); }
+
+    template <typename FunctionType>
+    void ForEach(FunctionType&& function) {
+        for (int32 i = 0; i < Slots.Num(); ++i)
+            if (Slots[i].Occupied) function(MakeHandle(i, Slots[i].Generation), Slots[i].Value);
+    }
+
+    template <typename FunctionType>
+    void ForEach(FunctionType&& function) const {
+        for (int32 i = 0; i < Slots.Num(); ++i)
+            if (Slots[i].Occupied) function(MakeHandle(i, Slots[i].Generation), static_cast<const T&>(Slots[i].Value));
+    }
+
+private:
+    struct Slot {
+        T Value = T();
+        uint32 Generation = 1;
+        bool Occupied = false;
+    };
+
+    static constexpr uint32 PoolCapacity = 256;
+
+    static int32 MakeHandle(int32 index, uint32 generation) { return int32((generation << IndexBits) | uint32(index)); }
+    static uint64 PoolState(uint64 tag, uint32 count) { return ((tag + 1) << 32) | count; }
+
+    int32 TakeFree() {
+        const int32 index = FreeList.Pop();
+        return MakeHandle(index, Slots[index].Generation);
+    }
+
+    // Only the game thread pushes, so the pool can't grow under it; a failed exchange means a worker popped
+    void TopUpPool() {
+        uint64 top = PoolTop.load(std::memory_order_relaxed);
+        while (FreeList.Num() > 0 && uint32(top) < PoolCapacity) {
+            Pool[uint32(top)].store(MakeHandle(FreeList.Last(), Slots[FreeList.Last()].Generation), std::memory_order_relaxed);
+            if (PoolTop.compare_exchange_weak(top, PoolState(top >> 32, uint32(top) + 1), std::memory_order_release))
+                FreeList.Pop();
+        }
+    }
+
+    // Slots whose generation would wrap are retired for good instead of risking a stale handle match
+    void Retire(int32 index) {
+        Slot& slot = Slots[index];
+        if (slot.Generation == MaxGeneration) return;
+        ++slot.Generation;
+        FreeList.Add(index);
+        TopUpPool();
+    }
+
+    TArray<Slot> Slots;
+    TArray<int32> FreeList;
+    std::atomic<int32> Pool[PoolCapacity] = {};
+    std::atomic<uint64> PoolTop{ 0 }; // Tag in the high half, number of pooled handles in the low half
+    std::atomic<int32> NextFresh{ 0 };
+    int32 Count = 0;
+};
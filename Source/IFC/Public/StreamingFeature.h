@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <flecs.h>
+#include "MeshBuildSettings.h"
+
+namespace IFC {
+	struct StreamingFeature {
+		static void CreateComponents(flecs::world& world);
+		static void CreateSystems(flecs::world& world);
+	};
+
+	struct StreamingCell {
+		TArray<flecs::entity_t> Objects;
+		FBox Bounds = FBox(ForceInit); // Instance bounds at assignment
+		TMap<flecs::entity_t, int32> Instances; // Mesh of each object given an instance while resident
+		bool Resident = false;
+	};
+	// Cells only hold instances; entities and attributes stay loaded so queries see the whole model
+	struct StreamingCells {
+		TMap<FIntVector, StreamingCell> Cells;
+		TMap<int32, int32> ResidentInstances; // Mesh -> instances in resident cells
+		FVector Viewpoint = FVector::ZeroVector;
+		bool HasViewpoint = false;
+	};
+
+	// Overrides the first player's camera, e.g. for editor or headless views
+	IFC_API void SetStreamingViewpoint(flecs::world& world, const FVector& location);
+	IFC_API void ClearStreamingViewpoint(flecs::world& world);
+	// Adds new objects to the cells their instance bounds center falls in; only objects in resident cells get instances now
+	void AssignStreamingCells(flecs::world& world, const MeshStreamingSettings& settings, TArrayView<const flecs::entity> objects, TArrayView<const FBox> bounds);
+	// Drops destroyed objects from their cells and their instances from the resident counts
+	void PruneStreamingCells(flecs::world& world);
+	// Loads the nearest cells within LoadDistance and unloads cells past UnloadDistance, or outside LoadDistance over the memory budget
+	void UpdateStreaming(flecs::world& world, const MeshStreamingSettings& settings);
+}
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <flecs.h>
+
+namespace IFC {
+	struct VisibilityFeature {
+		static void CreateComponents(flecs::world& world);
+	};
+
+	// Masks travel as float custom data, which holds integers exactly up to 2^24
+	constexpr int32 MAX_VISIBILITY_CATEGORIES = 24;
+
+	struct VisibilityMask { uint32 Value; }; // Category bits of one object
+	struct VisibilityCategories {
+		TMap<uint64, int32> Bits; // Layer, IFC class tag or system entity -> bit
+		uint32 Hidden = 0;
+	};
+
+	// Categories are Layer entities, IFC class tags (e.g. world.component<Space>()) or system entities.
+	// With the visibility collection and reserved mask channel a toggle is one shared parameter write,
+	// otherwise matching instances are collapsed or restored in one bulk transform update.
+	IFC_API bool SetCategoryVisible(flecs::world& world, flecs::entity category, bool visible);
+	IFC_API bool IsCategoryVisible(flecs::world& world, flecs::entity category);
+	// True when the object is hidden by collapsing its instance, which transform updates must keep
+	bool IsCollapsed(flecs::world& world, flecs::entity object);
+	// Computes the masks of new instances and writes them to the mask channel
+	void UpdateVisibilityMasks(flecs::world& world, TArrayView<const flecs::entity> objects);
+	// Frees the bits of removed categories, e.g. deleted layers, and shows what only they hid
+	void RemoveVisibilityCategories(flecs::world& world, TArrayView<const flecs::entity> categories);
+}